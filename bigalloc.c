@@ -0,0 +1,241 @@
+/* bigalloc.c - Allocation of large state tables, see bigalloc.h. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "bigalloc.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define PAGES_4K  0
+#define PAGES_THP 1
+#define PAGES_2M  2
+#define PAGES_1G  3
+
+static int initialized = 0;
+static int pages = PAGES_4K;
+static int prefault = 0;
+static struct rusage start_usage;
+static int tlb_fd = -1;
+static long page_sizes[4] = {4096L, 2L << 20, 2L << 20, 1L << 30};
+
+/* Mapped lengths, which depend on the page size actually obtained. */
+struct mapping {
+  void *p;
+  size_t length;
+  struct mapping *next;
+};
+static struct mapping *mappings = NULL;
+static pthread_mutex_t mappings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int
+open_tlb_counter(void)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = (PERF_COUNT_HW_CACHE_DTLB
+		 | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+		 | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.inherit = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void
+init(void)
+{
+  char *s;
+
+  initialized = 1;
+  if ((s = getenv("BIGALLOC_PAGES"))) {
+    if (!strcmp(s, "thp"))
+      pages = PAGES_THP;
+    else if (!strcmp(s, "2m"))
+      pages = PAGES_2M;
+    else if (!strcmp(s, "1g"))
+      pages = PAGES_1G;
+    else if (strcmp(s, "4k"))
+      fprintf(stderr, "bigalloc: unknown BIGALLOC_PAGES=%s, using 4k\n", s);
+  }
+  if ((s = getenv("BIGALLOC_PREFAULT")))
+    prefault = atoi(s);
+  if ((s = getenv("BIGALLOC_NODE"))) {
+    if (bigalloc_pin(atoi(s)))
+      prefault = 1;
+    else
+      fprintf(stderr, "bigalloc: could not pin to node %s\n", s);
+  }
+  getrusage(RUSAGE_SELF, &start_usage);
+  tlb_fd = open_tlb_counter();
+}
+
+/* Round up to a multiple of the page size. Huge pages are also used
+ * for the last partial page, the waste is small compared to the tables.
+ */
+static size_t
+round_size(size_t size, int page_type)
+{
+  size_t page_size = page_sizes[page_type];
+  return (size + page_size - 1) / page_size * page_size;
+}
+
+void *
+bigalloc(size_t size)
+{
+  void *p = MAP_FAILED;
+  struct mapping *m;
+  int page_type;
+  size_t k;
+
+  if (!initialized)
+    init();
+  if (size == 0)
+    return NULL;
+
+  page_type = pages;
+  if (page_type == PAGES_2M || page_type == PAGES_1G) {
+    p = mmap(NULL, round_size(size, page_type), PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB
+	     | (page_type == PAGES_2M ? MAP_HUGE_2MB : MAP_HUGE_1GB), -1, 0);
+    if (p == MAP_FAILED) {
+      fprintf(stderr, "bigalloc: no %s hugetlbfs pages for %lu bytes, "
+	      "using transparent huge pages\n",
+	      page_type == PAGES_2M ? "2 MB" : "1 GB", (unsigned long) size);
+      page_type = PAGES_THP;
+    }
+  }
+  if (p == MAP_FAILED) {
+    p = mmap(NULL, round_size(size, page_type), PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+      return NULL;
+#ifdef MADV_HUGEPAGE
+    if (page_type == PAGES_THP)
+      madvise(p, round_size(size, page_type), MADV_HUGEPAGE);
+#endif
+  }
+
+  if (!(m = malloc(sizeof(*m)))) {
+    munmap(p, round_size(size, page_type));
+    return NULL;
+  }
+  m->p = p;
+  m->length = round_size(size, page_type);
+  pthread_mutex_lock(&mappings_lock);
+  m->next = mappings;
+  mappings = m;
+  pthread_mutex_unlock(&mappings_lock);
+
+  if (prefault)
+    for (k = 0; k < size; k += 4096)
+      ((volatile char *) p)[k] = 0;
+
+  return p;
+}
+
+void
+bigfree(void *p, size_t size)
+{
+  struct mapping **m, *found = NULL;
+
+  pthread_mutex_lock(&mappings_lock);
+  for (m = &mappings; *m; m = &(*m)->next)
+    if ((*m)->p == p) {
+      found = *m;
+      *m = found->next;
+      break;
+    }
+  pthread_mutex_unlock(&mappings_lock);
+  if (found) {
+    munmap(p, found->length);
+    free(found);
+  }
+  else if (p)
+    fprintf(stderr, "bigalloc: freeing unknown pointer %p (%lu bytes)\n",
+	    p, (unsigned long) size);
+}
+
+int
+bigalloc_pin(int node)
+{
+  char filename[64];
+  cpu_set_t cpus;
+  FILE *f;
+  int from, to, c, n = 0;
+
+  sprintf(filename, "/sys/devices/system/node/node%d/cpulist", node);
+  if (!(f = fopen(filename, "r")))
+    return 0;
+  CPU_ZERO(&cpus);
+  /* The cpu list has the format "0-7,16-23". */
+  while (fscanf(f, "%d", &from) == 1) {
+    to = from;
+    if ((c = fgetc(f)) == '-') {
+      if (fscanf(f, "%d", &to) != 1)
+	break;
+      c = fgetc(f);
+    }
+    for (; from <= to; from++, n++)
+      CPU_SET(from, &cpus);
+    if (c != ',')
+      break;
+  }
+  fclose(f);
+  return n > 0 && sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+int
+bigalloc_pin_thread(int t)
+{
+  char *s;
+  int nodes;
+
+  if (!(s = getenv("BIGALLOC_NODES")) || (nodes = atoi(s)) < 1)
+    return 0;
+  if (!bigalloc_pin(t % nodes)) {
+    fprintf(stderr, "bigalloc: could not pin thread %d to node %d\n",
+	    t, t % nodes);
+    return 0;
+  }
+  return 1;
+}
+
+void
+bigalloc_report(void)
+{
+  struct rusage usage;
+  long long tlb_misses;
+
+  if (!initialized)
+    init();
+  getrusage(RUSAGE_SELF, &usage);
+  fprintf(stderr, "page faults: %ld minor, %ld major\n",
+	  usage.ru_minflt - start_usage.ru_minflt,
+	  usage.ru_majflt - start_usage.ru_majflt);
+  if (tlb_fd >= 0 && read(tlb_fd, &tlb_misses, sizeof(tlb_misses))
+      == sizeof(tlb_misses))
+    fprintf(stderr, "dTLB load misses: %lld\n", tlb_misses);
+  else
+    fprintf(stderr, "dTLB load misses: not available\n");
+}
@@ -0,0 +1,54 @@
+/* bigalloc.h - Allocation of large state tables.
+ *
+ * Tables are mmapped directly instead of going through malloc, so that
+ * the page size and NUMA placement can be controlled. This is
+ * configured from the environment:
+ *
+ * BIGALLOC_PAGES=4k   Plain pages (default).
+ * BIGALLOC_PAGES=thp  Transparent huge pages, requested with madvise.
+ * BIGALLOC_PAGES=2m   2 MB pages from the hugetlbfs pool.
+ * BIGALLOC_PAGES=1g   1 GB pages from the hugetlbfs pool.
+ *
+ * If the hugetlbfs pool is exhausted, allocation falls back to
+ * transparent huge pages.
+ *
+ * BIGALLOC_NODE=n     Pin the allocating thread to the cpus of NUMA node
+ *                     n and touch all pages at allocation time, so
+ *                     that the first-touch policy places them on node n.
+ * BIGALLOC_PREFAULT=1 Touch all pages at allocation time also without
+ *                     BIGALLOC_NODE.
+ * BIGALLOC_NODES=k    Multithreaded programs call bigalloc_pin_thread
+ *                     from each thread before allocating that thread's
+ *                     tables, which pins thread t to node t % k. As
+ *                     only thread t touches its tables, they are placed
+ *                     on the node it runs on.
+ */
+
+#ifndef _BIGALLOC_H_
+#define _BIGALLOC_H_
+
+#include <stddef.h>
+
+/* Allocate size bytes of zeroed memory. Returns NULL on failure. */
+void *bigalloc(size_t size);
+
+/* Free memory obtained from bigalloc. */
+void bigfree(void *p, size_t size);
+
+/* Pin the calling thread to the cpus of the given NUMA node. Returns 0
+ * on failure.
+ */
+int bigalloc_pin(int node);
+
+/* Pin the calling thread, number t of the program's workers, to node
+ * t % k if BIGALLOC_NODES=k is set. Returns 0 if it is not set or on
+ * failure.
+ */
+int bigalloc_pin_thread(int t);
+
+/* Print page fault and dTLB miss counts since the first call to
+ * bigalloc. The dTLB counts require perf events to be available.
+ */
+void bigalloc_report(void);
+
+#endif /* _BIGALLOC_H_ */
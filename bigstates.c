@@ -2,14 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
-
-#define MAXSTATEWIDTH 99
-
-typedef struct {
-  unsigned char type;
-  unsigned char left;
-  unsigned char right;
-} cell;
+#include "bigstates.h"
 
 //possible cell types
 #define EDGE  0
@@ -22,11 +15,9 @@ typedef struct {
 #define ISNEEDY(x) ((x) >= NEEDY)
 #define CELLCHARS "#.XOxo"
 
-#define NSHOWBUF 4
-
-typedef cell bstate[MAXSTATEWIDTH]; // bstate
-
 int statewidth; // global to save us from passing it to every function
+static char *showbuffers; // NSHOWBUF buffers of statewidth+1 chars
+static bstate start;
 
 void setwidth(int wd)
 {
@@ -35,15 +26,19 @@ void setwidth(int wd)
     exit(1);
   }
   statewidth = wd;
+  free(showbuffers);
+  free(start);
+  assert((showbuffers = malloc(NSHOWBUF * (wd+1))));
+  assert((start = malloc(STATEBYTES + 1))); // +1 as malloc(0) may fail
 }
 
 char *showstate(bstate state)
 {
-  static char buffers[NSHOWBUF][MAXSTATEWIDTH+1],*buf; // +1 for '\0'
+  static char *buf;
   static int bufnr = 0;
   int type,i,ngroups[2];
                                                                                 
-  buf = buffers[bufnr++];
+  buf = showbuffers + bufnr++ * (statewidth+1); // +1 for '\0'
   if (bufnr == NSHOWBUF)
     bufnr = 0; // buffer rotation
   for (i = ngroups[0] = ngroups[1] = 0; i < statewidth; i++) {
@@ -72,14 +67,56 @@ void liberatecell(bstate state, int x)
     mustliberatecell(state, x, state[x].type + LIBSTONE-NEEDY);
 }
                                                                                 
-bstate *startstate()
+bstate startstate()
 {
-  static bstate start;
   int i;
 
-  for (i = 0; i < statewidth; i++)
+  for (i = 0; i < statewidth; i++) {
     start[i].type = EDGE;
-  return &start;
+    start[i].left = start[i].right = i;
+  }
+  return start;
+}
+
+void canonstate(bstate state)
+{
+  int root[statewidth],last[statewidth]; // per cell, per leftmost cell
+  int i,j;
+
+  for (i = 0; i < statewidth; i++)
+    root[i] = -1;
+  for (i = 0; i < statewidth; i++) {
+    if (!ISNEEDY(state[i].type)) {
+      state[i].left = state[i].right = i;
+      continue;
+    }
+    if (root[i] < 0) { // leftmost cell of its string, whose links are intact
+      j = i;
+      do root[j] = i;
+      while ((j = state[j].right) != i);
+      last[i] = i;
+    } else {
+      state[i].left = last[root[i]];
+      state[last[root[i]]].right = i;
+      last[root[i]] = i;
+    }
+  }
+  for (i = 0; i < statewidth; i++)
+    if (root[i] == i) { // close the cycle
+      state[i].left = last[i];
+      state[last[i]].right = i;
+    }
+}
+
+unsigned long hashstate(bstate state)
+{
+  unsigned long h = 0L;
+  int i;
+
+  for (i = 0; i < statewidth; i++)
+    h = (h + (state[i].type | state[i].left << 4 | (unsigned long)state[i].right << 18))
+      * 0x9e3779b97f4a7c15UL;
+  return h ^ h >> 32;
 }
 
 int finalstate(bstate state)
@@ -111,31 +148,30 @@ int stratify(bstate state)
 #endif
 }
 
-int expandstate(bstate state, int x, bstate *new)
+int expandstate(bstate state, int x, bstate new)
 {
   int nnew=0, col;
   cell *stx, left, up, edge;
-  bstate t;
+  bstate t = new; // successors are built in place
                                                                                 
   edge.type = EDGE; ; edge.left = edge.right = x;
   up = state[x];
   left = x ? state[x-1] : edge;
   // extend border with liberty at (x,y)
-  memcpy(t,state,sizeof(bstate));
+  memcpy(t,state,STATEBYTES);
   liberatecell(t, x);
   if (x > 0)
     liberatecell(t, x-1);
   t[x].type = EMPTY;
-  memcpy(new[nnew++],t,sizeof(bstate));
+  t = NTHSTATE(new, ++nnew);
   for (col=0; col<2; col++) {
-    memcpy(t,state,sizeof(bstate));
-    stx = &t[x];
     // extend border with stone at (x,y)
-    if (up.type == ((NEEDY|col) ^ COLOR)) {
-      if (up.left == x) // singleton string
-        continue; // don't deprive last liberty
+    if (up.type == ((NEEDY|col) ^ COLOR) && up.left == x) // singleton string
+      continue; // don't deprive last liberty
+    memcpy(t,state,STATEBYTES);
+    stx = &t[x];
+    if (up.type == ((NEEDY|col) ^ COLOR))
       t[t[up.right].left = up.left].right = up.right; // unlink
-    }
     if (left.type == EMPTY || left.type == (LIBSTONE|col)) {
       if (up.type == (NEEDY|col))
         mustliberatecell(t, x, LIBSTONE|col);
@@ -154,7 +190,7 @@ int expandstate(bstate state, int x, bstate *new)
         t[stx->left = x-1].right = x;
       }
     }
-    memcpy(new[nnew++],t,sizeof(bstate));
+    t = NTHSTATE(new, ++nnew);
   }
   return nnew;
 }
@@ -164,9 +200,8 @@ unsigned long cnt;
 
 void visit(bstate s, int y, int x)
 {
-  bstate new[3];
+  cell new[3*statewidth];
   int i,nnew;
-  bstate state;
 
   if (y == statewidth) {
     cnt += finalstate(s);
@@ -174,17 +209,13 @@ void visit(bstate s, int y, int x)
   }
   nnew = expandstate(s, x, new);
   for (i=0; i<nnew; i++)
-    visit(new[i], y+(x+1)/statewidth, (x+1)%statewidth);
+    visit(NTHSTATE(new,i), y+(x+1)/statewidth, (x+1)%statewidth);
 }
 
 int main()
 {
-  bstate s,new[3];
-  int i,nnew,x;
-  bstate state;
- 
   setwidth(4);
-  visit(*startstate(),0,0);
+  visit(startstate(),0,0);
   printf("cnt = %lu\n", cnt);
 }
 #endif
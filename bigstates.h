@@ -1,27 +1,49 @@
-#define MAXSTATEWIDTH 99
+#define LINKBITS 14
+#define MAXSTATEWIDTH (1 << LINKBITS)
 #define NSHOWBUF 4
 
+// a cell packs its type with the positions of its neighbours on the
+// circular list of needy cells of the same string, in one 32 bit word
+// without padding bits, so that states can be compared with memcmp
 typedef struct {
-  unsigned char type;
-  unsigned char left;
-  unsigned char right;
+  unsigned int type : 4;
+  unsigned int left : LINKBITS;
+  unsigned int right : LINKBITS;
 } cell;
 
-typedef cell bstate[MAXSTATEWIDTH]; // borderstate
+// a border state is statewidth consecutive cells, so copying one costs
+// time proportional to the width. arrays of states are plain arrays of
+// cells, allocated with STATEBYTES per state and indexed with NTHSTATE
+typedef cell *bstate;
+
+extern int statewidth;
+
+#define STATEBYTES (statewidth * sizeof(cell))
+#define NTHSTATE(s,i) ((s) + (long)(i) * statewidth)
 
 void setwidth(int statewidth);
 
-bstate *startstate();
+// the state before the first row, overwritten by the next setwidth
+bstate startstate();
 
+// return a stratum in [0,statewidth]
 int stratify(bstate state);
 
+// relink the needy cells of every string in increasing order and point
+// the links of all other cells at themselves, so that equal borders have
+// equal representations
+void canonstate(bstate s);
+
+// hash of a canonical state
+unsigned long hashstate(bstate s);
+
 // rotates through NSHOWBUF output buffers
 // so it can be called multiple times in printf
-char *showstate(bstate s, int x);
+char *showstate(bstate s);
 
 // return whether s encodes a legal final state or not
 int finalstate(bstate s);
 
-// fill new with successor states of s
+// write the successor states of s to new, which has room for 3 states
 // return number of new states, up to 3
-int expandstate(bstate s, int x, bstate *new);
+int expandstate(bstate s, int x, bstate new);
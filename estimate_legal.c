@@ -1,96 +1,692 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <time.h>
+#include <pthread.h>
 #include "states.h"
 #include "random.h"
+#include "stats.h"
 
-#define N 10000
+#define DEFAULT_POPULATION 10000
 
-static unsigned int random_choice(unsigned int n)
+/* Resampling schemes for drawing the population of the next cell from
+ * the num_outstates equally weighted successors. Multinomial draws
+ * every state independently. Systematic takes the states at k + u
+ * for a single uniform u, stratified at k + u_k with one uniform per
+ * stratum, both in units of num_outstates / population successors. These two
+ * first sort the successors: in expansion order the children of a
+ * parent repeat with period up to 3, and a step of 3 would then make
+ * the whole population take the same move. Sorted, equal states are
+ * picked in proportion to their multiplicity. Residual merges equal
+ * successors, keeps floor(population * multiplicity / num_outstates)
+ * copies of every state and draws the rest multinomially in proportion
+ * to the remainders. The weighted mode below uses the same
+ * schemes on weights instead of multiplicities.
+ */
+#define MULTINOMIAL 0
+#define SYSTEMATIC 1
+#define STRATIFIED 2
+#define RESIDUAL 3
+#define NUM_RESAMPLINGS 4
+
+static const char *resampling_names[NUM_RESAMPLINGS] = {
+  "multinomial", "systematic", "stratified", "residual"
+};
+
+/* Replicas are dealt out round robin, replica j to thread j % num_threads,
+ * and each thread draws from its own stream of the seed. The estimates
+ * are collected per replica and summed in replica order, so the output
+ * is determined by the seed and the thread count. With a target
+ * relative standard error the replicas run in batches of one per
+ * thread, and the run stops after the first batch that reaches it.
+ */
+static int height;
+static int width;
+static int num_iterations = 100;
+static int num_threads = 1;
+static unsigned int seed;
+static double *estimates;
+static double target_rse = 0.0;
+static struct gg_rand_buffer *thread_rand;
+static int batch_begin;
+static int batch_end;
+static int resampling = MULTINOMIAL;
+static int population = DEFAULT_POPULATION;
+
+/* In weighted mode (--ess f) every particle moves to one of its
+ * successors chosen uniformly and multiplies its weight by the number
+ * of successors over 3, so that the mean weight estimates the legal
+ * fraction of the cells so far. The population is only resampled,
+ * with all weights reset to the mean, when the effective sample size
+ * (sum w)^2 / sum w^2 drops below f times the population. Otherwise
+ * the particles keep their own histories, which avoids the loss of
+ * diversity that resampling after every cell causes on large boards.
+ */
+struct particle
 {
-  unsigned int k;
-  unsigned int r = 0xffffffffU % n;
+  Word_t state;
+  double weight;
+};
 
-  do {
-    k = gg_urand();
-  } while (k < r);
+/* In deduplicating mode (--dedup) every particle is expanded into all
+ * its successors with a third of its weight, and successors with equal
+ * states are merged by adding their weights. As long as the merged
+ * states fit in the population this is the exact transfer; only when
+ * they do not is the population resampled down with the selected
+ * scheme.
+ */
+static double ess_threshold = 0.0;
+static int dedup = 0;
+static int *resample_counts;
 
-  return k % n;
+/* In lookahead mode (--lookahead b) the weighted mode moves every
+ * particle in the last row to a successor chosen in proportion to a
+ * guess h of its chance to complete legally, rather than uniformly, and
+ * multiplies its weight by (sum of h) / (3 h) of the chosen successor,
+ * which keeps the estimate unbiased as long as h is positive whenever
+ * that chance is. In the last row a needy string whose border cells
+ * all lie left of the cell just placed can no longer get a liberty, so
+ * h is 0 for it; otherwise a needy string of m border cells is guessed
+ * to get one with probability 1 - b^m, independently of the others.
+ * Before the last row the guesses cost more than they gain.
+ */
+static double lookahead = 0.0;
+
+/* Sort a[0..n-1] with a radix sort on bytes, using tmp as scratch.
+ * Only the bytes in which some state is nonzero take a pass.
+ */
+static void
+sort_states(Word_t *a, Word_t *tmp, int n)
+{
+  int count[256];
+  Word_t all = 0;
+  Word_t *from = a, *to = tmp, *swap;
+  int shift, i, sum, c;
+
+  for (i = 0; i < n; i++)
+    all |= a[i];
+  for (shift = 0; shift < 64 && (all >> shift); shift += 8) {
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n; i++)
+      count[(from[i] >> shift) & 255]++;
+    for (sum = i = 0; i < 256; i++) {
+      c = count[i];
+      count[i] = sum;
+      sum += c;
+    }
+    for (i = 0; i < n; i++)
+      to[count[(from[i] >> shift) & 255]++] = from[i];
+    swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from != a)
+    memcpy(a, from, n * sizeof(Word_t));
 }
 
-int
-main(int argc, char **argv)
+/* Sort particles by state in the same way as sort_states(). */
+static void
+sort_particles(struct particle *a, struct particle *tmp, int n)
 {
-  static Word_t states[N];
-  static Word_t out_states[3 * N];
+  int count[256];
+  Word_t all = 0;
+  struct particle *from = a, *to = tmp, *swap;
+  int shift, i, sum, c;
 
-  int num_outstates = 0;
-  int j;
-  int k;
-  int x, y;
-  double sum_p = 0.0;
-  double sum_squared_p = 0.0;
-  int num_legal_final_states;
-  int height;
-  int width;
-  int num_iterations = 100;
+  for (i = 0; i < n; i++)
+    all |= a[i].state;
+  for (shift = 0; shift < 64 && (all >> shift); shift += 8) {
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n; i++)
+      count[(from[i].state >> shift) & 255]++;
+    for (sum = i = 0; i < 256; i++) {
+      c = count[i];
+      count[i] = sum;
+      sum += c;
+    }
+    for (i = 0; i < n; i++)
+      to[count[(from[i].state >> shift) & 255]++] = from[i];
+    swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from != a)
+    memcpy(a, from, n * sizeof(struct particle));
+}
 
-  if (argc < 5) {
-    fprintf(stderr, "Usage: estimate_legal_stratified <height> <width> <num_samples> <seed>\n");
-    return 1;
+/* Return the first index whose cumulative count exceeds target. */
+static int
+find_cumulative_count(Word_t *cumulative, int n, Word_t target)
+{
+  int lo = 0, hi = n - 1, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (cumulative[mid] > target)
+      hi = mid;
+    else
+      lo = mid + 1;
   }
+  return lo;
+}
 
-  height = atoi(argv[1]);
-  width = atoi(argv[2]);
-  num_iterations = atoi(argv[3]);
-  gg_srand(atoi(argv[4]));
-  setwidth(height);
+static void
+resample(struct gg_rand_buffer *rb, Word_t *states, Word_t *out_states,
+	 Word_t *scratch, int num_outstates)
+{
+  double step = (double) num_outstates / population;
+  double u;
+  Word_t share, total;
+  int k, m, r, i;
+
+  switch (resampling) {
+  case SYSTEMATIC:
+    sort_states(out_states, scratch, num_outstates);
+    u = gg_drand_b(rb);
+    for (k = 0; k < population; k++) {
+      m = (int) ((k + u) * step);
+      states[k] = out_states[m < num_outstates ? m : num_outstates - 1];
+    }
+    break;
+
+  case STRATIFIED:
+    sort_states(out_states, scratch, num_outstates);
+    for (k = 0; k < population; k++) {
+      m = (int) ((k + gg_drand_b(rb)) * step);
+      states[k] = out_states[m < num_outstates ? m : num_outstates - 1];
+    }
+    break;
+
+  case RESIDUAL:
+    /* The run of equal states out_states[m..r-1] is due population *
+     * (r - m) / num_outstates copies. The remainders, in units of
+     * 1 / num_outstates, are summed in scratch over the run, so that
+     * the search below lands on the first state of a run.
+     */
+    sort_states(out_states, scratch, num_outstates);
+    k = 0;
+    total = 0;
+    for (m = 0; m < num_outstates; m = r) {
+      for (r = m + 1; r < num_outstates && out_states[r] == out_states[m]; r++)
+	;
+      share = (Word_t) population * (r - m);
+      for (i = share / num_outstates; i > 0; i--)
+	states[k++] = out_states[m];
+      total += share % num_outstates;
+      for (i = m; i < r; i++)
+	scratch[i] = total;
+    }
+    for (; k < population; k++)
+      states[k] = out_states[find_cumulative_count(scratch, num_outstates,
+						   gg_drand_b(rb) * total)];
+    break;
 
-  for (j = 0; j < num_iterations; j++) {
-    double p = 1.0;
+  default:
+    for (k = 0; k < population; k++)
+      states[k] = out_states[gg_choice_b(rb, num_outstates)];
+    break;
+  }
+}
+
+/* Return the first index whose cumulative weight exceeds target. */
+static int
+find_cumulative(double *cumulative, int n, double target)
+{
+  int lo = 0, hi = n - 1, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (cumulative[mid] > target)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+/* Resample the m weighted particles to n particles of the mean weight
+ * with the selected scheme, in place. sorted tells whether the
+ * particles are already sorted by state.
+ */
+static void
+resample_weighted(struct gg_rand_buffer *rb, struct particle *particles,
+		  int m, int n, struct particle *scratch, double *cumulative,
+		  int sorted)
+{
+  double total, mean, u;
+  int copies;
+  int i, k, r;
+
+  if (!sorted && (resampling == SYSTEMATIC || resampling == STRATIFIED))
+    sort_particles(particles, scratch, m);
+  for (total = 0.0, i = 0; i < m; i++)
+    cumulative[i] = total += particles[i].weight;
+  mean = total / n;
+
+  switch (resampling) {
+  case SYSTEMATIC:
+  case STRATIFIED:
+    u = gg_drand_b(rb);
+    for (i = k = 0; k < n; k++) {
+      if (resampling == STRATIFIED)
+	u = gg_drand_b(rb);
+      while (i < m - 1 && cumulative[i] <= (k + u) * mean)
+	i++;
+      scratch[k] = particles[i];
+    }
+    break;
+
+  case RESIDUAL:
+    k = 0;
+    for (total = 0.0, i = 0; i < m; i++) {
+      copies = (int) (particles[i].weight / mean);
+      for (r = 0; r < copies && k < n; r++)
+	scratch[k++] = particles[i];
+      cumulative[i] = total += particles[i].weight - copies * mean;
+    }
+    for (; k < n; k++)
+      scratch[k] = particles[find_cumulative(cumulative, m,
+					     gg_drand_b(rb) * total)];
+    break;
+
+  default:
+    for (k = 0; k < n; k++)
+      scratch[k] = particles[find_cumulative(cumulative, m,
+					     gg_drand_b(rb) * total)];
+    break;
+  }
+
+  for (k = 0; k < n; k++) {
+    particles[k].state = scratch[k].state;
+    particles[k].weight = mean;
+  }
+}
+
+/* The guess for a successor in the last row after placing cell x. */
+static double
+completion_guess(Word_t s, int x)
+{
+  int sizes[64 / 3];
+  int rightmost[64 / 3];
+  int n, i;
+  double h = 1.0;
+
+  n = needystrings(s, (x + 1) % height, sizes, rightmost);
+  for (i = 0; i < n; i++) {
+    if (rightmost[i] < x)
+      return 0.0;
+    h *= 1.0 - pow(lookahead, sizes[i]);
+  }
+  return h;
+}
+
+static double
+estimate_replica(struct gg_rand_buffer *rb, Word_t *states, Word_t *out_states,
+		 Word_t *scratch)
+{
+  int num_outstates = 0;
+  int k;
+  int x, y;
+  int num_legal_final_states;
+  double p = 1.0;
     
-    for (k = 0; k < N; k++)
-      states[k] = STARTSTATE;
+  for (k = 0; k < population; k++)
+    states[k] = STARTSTATE;
     
-    for (y = 0; y < width; y++)
-      for (x = 0; x < height; x++) {
-	num_outstates = 0;
+  for (y = 0; y < width; y++)
+    for (x = 0; x < height; x++) {
+      num_outstates = 0;
 	
-	for (k = 0; k < N; k++) {
-	  Word_t expanded_states[3];
-	  int num_expanded_states;
-	  int m;
-	  num_expanded_states = expandstate(states[k], x, expanded_states);
-	  for (m = 0; m < num_expanded_states; m++) {
-	    out_states[num_outstates++] = expanded_states[m];
-	  }
+      for (k = 0; k < population; k++) {
+	Word_t expanded_states[3];
+	int num_expanded_states;
+	int m;
+	num_expanded_states = expandstate(states[k], x, expanded_states);
+	for (m = 0; m < num_expanded_states; m++) {
+	  out_states[num_outstates++] = expanded_states[m];
 	}
+      }
 	
-	p *= (double) num_outstates / (3 * N);
+      p *= (double) num_outstates / (3 * population);
 	
-	for (k = 0; k < N; k++)
-	  states[k] = out_states[random_choice(num_outstates)];
-      }
+      resample(rb, states, out_states, scratch, num_outstates);
+    }
     
-    num_legal_final_states = 0;
-    for (k = 0; k < num_outstates; k++)
-      num_legal_final_states += finalstate(out_states[k]);
+  num_legal_final_states = 0;
+  for (k = 0; k < num_outstates; k++)
+    num_legal_final_states += finalstate(out_states[k]);
     
-    p *= (double) num_legal_final_states / num_outstates;
-    sum_p += p;
-    sum_squared_p += p * p;
-    if ((j + 1) % 10 == 0) {
-      double std = sqrt(sum_squared_p - sum_p * sum_p / (j + 1)) / j;
-      printf("%d %10.8lg %lg %lg\n", j + 1, sum_p / (j + 1),
-	     std, std * sqrt(j));
+  p *= (double) num_legal_final_states / num_outstates;
+  return p;
+}
+
+static double
+estimate_replica_weighted(struct gg_rand_buffer *rb, struct particle *particles,
+			  struct particle *scratch, double *cumulative,
+			  int *num_resamplings)
+{
+  int k;
+  int x, y;
+  double sum_w, sum_w2;
+  double p = 0.0;
+
+  for (k = 0; k < population; k++) {
+    particles[k].state = STARTSTATE;
+    particles[k].weight = 1.0;
+  }
+  *num_resamplings = 0;
+
+  for (y = 0; y < width; y++)
+    for (x = 0; x < height; x++) {
+      sum_w = 0.0;
+      sum_w2 = 0.0;
+      for (k = 0; k < population; k++) {
+	Word_t expanded_states[3];
+	int num_expanded_states;
+	double w;
+	num_expanded_states = expandstate(particles[k].state, x,
+					  expanded_states);
+	if (lookahead > 0.0 && y == width - 1 && num_expanded_states > 1) {
+	  double h[3], sum_h = 0.0, u;
+	  int m;
+	  for (m = 0; m < num_expanded_states; m++)
+	    sum_h += h[m] = completion_guess(expanded_states[m], x);
+	  u = gg_drand_b(rb) * sum_h;
+	  for (m = 0; m < num_expanded_states - 1 && u >= h[m]; m++)
+	    u -= h[m];
+	  particles[k].state = expanded_states[m];
+	  /* With no successor left that can complete the weight is 0. */
+	  w = particles[k].weight *= sum_h > 0.0 ? sum_h / (3.0 * h[m]) : 0.0;
+	}
+	else {
+	  particles[k].state = expanded_states[num_expanded_states > 1
+					       ? gg_choice_b(rb, num_expanded_states)
+					       : 0];
+	  w = particles[k].weight *= num_expanded_states / 3.0;
+	}
+	sum_w += w;
+	sum_w2 += w * w;
+      }
+
+      if (sum_w * sum_w < ess_threshold * population * sum_w2) {
+	resample_weighted(rb, particles, population, population, scratch,
+			  cumulative, 0);
+	(*num_resamplings)++;
+      }
+    }
+
+  for (k = 0; k < population; k++)
+    if (finalstate(particles[k].state))
+      p += particles[k].weight;
+  return p / population;
+}
+
+static double
+estimate_replica_dedup(struct gg_rand_buffer *rb, struct particle *particles,
+		       struct particle *children, struct particle *scratch,
+		       double *cumulative, int *num_resamplings)
+{
+  struct particle *tmp;
+  int num_particles = 1;
+  int num_children;
+  int i, k;
+  int x, y;
+  double p = 0.0;
+
+  particles[0].state = STARTSTATE;
+  particles[0].weight = 1.0;
+  *num_resamplings = 0;
+
+  for (y = 0; y < width; y++)
+    for (x = 0; x < height; x++) {
+      num_children = 0;
+      for (k = 0; k < num_particles; k++) {
+	Word_t expanded_states[3];
+	int num_expanded_states;
+	int m;
+	num_expanded_states = expandstate(particles[k].state, x,
+					  expanded_states);
+	for (m = 0; m < num_expanded_states; m++) {
+	  children[num_children].state = expanded_states[m];
+	  children[num_children++].weight = particles[k].weight / 3.0;
+	}
+      }
+
+      sort_particles(children, scratch, num_children);
+      for (i = k = 0; k < num_children; k++)
+	if (i > 0 && children[i - 1].state == children[k].state)
+	  children[i - 1].weight += children[k].weight;
+	else
+	  children[i++] = children[k];
+      num_children = i;
+
+      if (num_children > population) {
+	resample_weighted(rb, children, num_children, population, scratch,
+			  cumulative, 1);
+	num_children = population;
+	(*num_resamplings)++;
+      }
+      tmp = particles;
+      particles = children;
+      children = tmp;
+      num_particles = num_children;
+    }
+
+  for (k = 0; k < num_particles; k++)
+    if (finalstate(particles[k].state))
+      p += particles[k].weight;
+  return p;
+}
+
+static void *
+worker(void *arg)
+{
+  int thread = (long) arg;
+  struct gg_rand_buffer *rb = &thread_rand[thread];
+  int first = batch_begin + ((thread - batch_begin) % num_threads
+			     + num_threads) % num_threads;
+  int j;
+
+  if (dedup) {
+    /* The two arrays swap roles every cell. */
+    struct particle *particles = malloc(3 * population * sizeof(struct particle));
+    struct particle *children = malloc(3 * population * sizeof(struct particle));
+    struct particle *scratch = malloc(3 * population * sizeof(struct particle));
+    double *cumulative = malloc(3 * population * sizeof(double));
+
+    if (!particles || !children || !scratch || !cumulative) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    for (j = first; j < batch_end; j += num_threads)
+      estimates[j] = estimate_replica_dedup(rb, particles, children, scratch,
+					    cumulative, &resample_counts[j]);
+    free(particles);
+    free(children);
+    free(scratch);
+    free(cumulative);
+  }
+  else if (ess_threshold > 0.0) {
+    struct particle *particles = malloc(population * sizeof(struct particle));
+    struct particle *scratch = malloc(population * sizeof(struct particle));
+    double *cumulative = malloc(population * sizeof(double));
+
+    if (!particles || !scratch || !cumulative) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    for (j = first; j < batch_end; j += num_threads)
+      estimates[j] = estimate_replica_weighted(rb, particles, scratch,
+					       cumulative, &resample_counts[j]);
+    free(particles);
+    free(scratch);
+    free(cumulative);
+  }
+  else {
+    Word_t *states = malloc(population * sizeof(Word_t));
+    Word_t *out_states = malloc(3 * population * sizeof(Word_t));
+    Word_t *scratch = malloc(3 * population * sizeof(Word_t));
+
+    if (!states || !out_states || !scratch) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    for (j = first; j < batch_end; j += num_threads)
+      estimates[j] = estimate_replica(rb, states, out_states, scratch);
+    free(states);
+    free(out_states);
+    free(scratch);
+  }
+  return NULL;
+}
+
+/* Run the replicas from batch_begin to batch_end on the threads. */
+static void
+run_batch(void)
+{
+  pthread_t *threads;
+  long t;
+
+  threads = malloc(num_threads * sizeof(pthread_t));
+  if (!threads) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (t = 0; t < num_threads; t++)
+    if (pthread_create(&threads[t], NULL, worker, (void *) t)) {
+      fprintf(stderr, "Cannot create thread %ld\n", t);
+      exit(1);
+    }
+  for (t = 0; t < num_threads; t++)
+    pthread_join(threads[t], NULL);
+  free(threads);
+}
+
+/* Run all replicas with the current resampling scheme and print the
+ * statistics, including the variance per sample times the CPU seconds
+ * per sample, which compares schemes of different cost.
+ */
+static void
+run_replicas(void)
+{
+  struct gg_stats stats;
+  long t;
+  int j;
+  double cpu_seconds;
+  clock_t start = clock();
+
+  for (t = 0; t < num_threads; t++)
+    gg_srand_buffer(&thread_rand[t], seed, t);
+  gg_stats_init(&stats);
+
+  for (batch_begin = 0; batch_begin < num_iterations; batch_begin = batch_end) {
+    batch_end = num_iterations;
+    if (target_rse > 0.0 && batch_begin + num_threads < num_iterations)
+      batch_end = batch_begin + num_threads;
+    run_batch();
+
+    for (j = batch_begin; j < batch_end; j++) {
+      gg_stats_add(&stats, estimates[j]);
+      if ((j + 1) % 10 == 0) {
+	double std = sqrt(stats.m2) / j;
+	printf("%d %10.8lg %lg %lg\n", j + 1, stats.mean,
+	       std, std * sqrt(j));
+      }
+    }
+    if (target_rse > 0.0 && gg_stats_reached(&stats, target_rse)) {
+      printf("Reached relative standard error %lg after %ld samples\n",
+	     gg_stats_rse(&stats), stats.n);
+      break;
     }
   }
+  cpu_seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
       
-  printf("Estimated legal probability: %10.8lg\n", sum_p / num_iterations);
-  printf("Standard deviation: %lg\n",
-	 sqrt(sum_squared_p - sum_p * sum_p / num_iterations) / num_iterations);
+  printf("Resampling: %s\n", resampling_names[resampling]);
+  printf("Estimated legal probability: %10.8lg\n", stats.mean);
+  printf("Standard deviation: %lg\n", sqrt(stats.m2) / stats.n);
   printf("Standard deviation per sample: %lg\n",
-	 sqrt((sum_squared_p - sum_p * sum_p / num_iterations) / num_iterations));
+	 sqrt(gg_stats_variance(&stats)));
+  printf("CPU seconds: %lg\n", cpu_seconds);
+  printf("Variance per sample times CPU seconds per sample: %lg\n",
+	 gg_stats_variance(&stats) * cpu_seconds / stats.n);
+  if (dedup || ess_threshold > 0.0) {
+    double sum_resamplings = 0.0;
+    for (j = 0; j < stats.n; j++)
+      sum_resamplings += resample_counts[j];
+    if (dedup)
+      printf("Cells per replica with more distinct states than particles: %lg of %d\n",
+	     sum_resamplings / stats.n, height * width);
+    else
+      printf("Resamplings per replica at ESS threshold %lg: %lg of %d cells\n",
+	     ess_threshold, sum_resamplings / stats.n, height * width);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  char **args = argv;
+  int nargs = 0;
+  int use_lookahead = 0;
+  int i;
+
+  /* Options may appear anywhere, the rest are positional. */
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--population") && i + 1 < argc)
+      population = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--ess") && i + 1 < argc)
+      ess_threshold = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--lookahead") && i + 1 < argc) {
+      lookahead = atof(argv[++i]);
+      use_lookahead = 1;
+    }
+    else if (!strcmp(argv[i], "--dedup"))
+      dedup = 1;
+    else if (gg_parse_target_rse(argc, argv, &i, &target_rse))
+      ;
+    else
+      args[++nargs] = argv[i];
+  }
+
+  if (nargs < 4 || population < 1
+      || (use_lookahead && (lookahead <= 0.0 || lookahead >= 1.0
+			    || dedup || ess_threshold <= 0.0))) {
+    fprintf(stderr, "Usage: estimate_legal [--population n] [--ess fraction [--lookahead b] | --dedup] [--target-rse r] <height> <width> <num_samples> <seed> [num_threads [multinomial|systematic|stratified|residual|all]]\n");
+    return 1;
+  }
+
+  height = atoi(args[1]);
+  width = atoi(args[2]);
+  num_iterations = atoi(args[3]);
+  seed = atoi(args[4]);
+  if (nargs > 4)
+    num_threads = atoi(args[5]);
+  if (num_threads < 1)
+    num_threads = 1;
+  if (nargs > 5) {
+    for (resampling = 0; resampling < NUM_RESAMPLINGS; resampling++)
+      if (!strcmp(args[6], resampling_names[resampling]))
+	break;
+    if (resampling == NUM_RESAMPLINGS && strcmp(args[6], "all")) {
+      fprintf(stderr, "Unknown resampling scheme %s\n", args[6]);
+      return 1;
+    }
+  }
+  setwidth(height);
+
+  estimates = malloc(num_iterations * sizeof(double));
+  resample_counts = malloc(num_iterations * sizeof(int));
+  thread_rand = malloc(num_threads * sizeof(struct gg_rand_buffer));
+  if (!estimates || !resample_counts || !thread_rand) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  if (resampling < NUM_RESAMPLINGS)
+    run_replicas();
+  else
+    for (resampling = 0; resampling < NUM_RESAMPLINGS; resampling++)
+      run_replicas();
   
   return 0;
 }
@@ -2,96 +2,187 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include "bigstates.h"
 #include "random.h"
+#include "stats.h"
 
 #define N 10000
 
-static unsigned int random_choice(unsigned int n)
+/* Replicas are dealt out round robin, replica j to thread j % num_threads,
+ * and each thread draws from its own stream of the seed. The estimates
+ * are collected per replica and summed in replica order. See
+ * estimate_legal.c.
+ */
+static int height;
+static int width;
+static int num_iterations = 100;
+static int num_threads = 1;
+static unsigned int seed;
+static bstate start; /* from startstate(), only read by the threads */
+static double *estimates;
+static double target_rse = 0.0;
+static struct gg_rand_buffer *thread_rand;
+static int batch_begin;
+static int batch_end;
+
+/* The successors of a step are expanded in place into one of the two
+ * out_states buffers, alternately, and the resampled population only
+ * points into the buffer of the previous step, so no state is copied
+ * outside expandstate.
+ */
+static double
+estimate_replica(struct gg_rand_buffer *rb, bstate *states, bstate out_states[2])
 {
-  unsigned int k;
-  unsigned int r = 0xffffffffU % n;
+  bstate out = start;
+  int cur = 0;
+  int num_outstates = 0;
+  int k;
+  int x, y;
+  int num_legal_final_states;
+  double p = 1.0;
+    
+  for (k = 0; k < N; k++)
+    states[k] = start;
+    
+  for (y = 0; y < width; y++)
+    for (x = 0; x < height; x++) {
+      out = out_states[cur];
+      cur ^= 1;
+      num_outstates = 0;
+	
+      for (k = 0; k < N; k++)
+	num_outstates += expandstate(states[k], x,
+				     NTHSTATE(out, num_outstates));
+	
+      p *= (double) num_outstates / (3 * N);
+	
+      for (k = 0; k < N; k++)
+	states[k] = NTHSTATE(out, gg_choice_b(rb, num_outstates));
+    }
+    
+  num_legal_final_states = 0;
+  for (k = 0; k < num_outstates; k++)
+    num_legal_final_states += finalstate(NTHSTATE(out, k));
+    
+  p *= (double) num_legal_final_states / num_outstates;
+  return p;
+}
 
-  do {
-    k = gg_urand();
-  } while (k < r);
+static void *
+worker(void *arg)
+{
+  int thread = (long) arg;
+  struct gg_rand_buffer *rb = &thread_rand[thread];
+  int first = batch_begin + ((thread - batch_begin) % num_threads
+			     + num_threads) % num_threads;
+  bstate *states = malloc(N * sizeof(bstate));
+  bstate out_states[2];
+  int j;
 
-  return k % n;
+  out_states[0] = malloc(3 * N * STATEBYTES);
+  out_states[1] = malloc(3 * N * STATEBYTES);
+  if (!states || !out_states[0] || !out_states[1]) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (j = first; j < batch_end; j += num_threads)
+    estimates[j] = estimate_replica(rb, states, out_states);
+  free(states);
+  free(out_states[0]);
+  free(out_states[1]);
+  return NULL;
+}
+
+/* Run the replicas from batch_begin to batch_end on the threads. */
+static void
+run_batch(void)
+{
+  pthread_t *threads;
+  long t;
+
+  threads = malloc(num_threads * sizeof(pthread_t));
+  if (!threads) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (t = 0; t < num_threads; t++)
+    if (pthread_create(&threads[t], NULL, worker, (void *) t)) {
+      fprintf(stderr, "Cannot create thread %ld\n", t);
+      exit(1);
+    }
+  for (t = 0; t < num_threads; t++)
+    pthread_join(threads[t], NULL);
+  free(threads);
 }
 
 int
 main(int argc, char **argv)
 {
-  static bstate states[N];
-  static bstate out_states[3 * N];
+  struct gg_stats stats;
+  char **args = argv;
+  int nargs = 0;
+  long t;
+  int i, j;
 
-  int num_outstates = 0;
-  int j;
-  int k;
-  int x, y;
-  double sum_p = 0.0;
-  double sum_squared_p = 0.0;
-  int num_legal_final_states;
-  int height;
-  int width;
-  int num_iterations = 100;
+  for (i = 1; i < argc; i++)
+    if (!gg_parse_target_rse(argc, argv, &i, &target_rse))
+      args[++nargs] = argv[i];
 
-  if (argc < 5) {
-    fprintf(stderr, "Usage: estimate_legal_stratified <height> <width> <num_samples> <seed>\n");
+  if (nargs < 4) {
+    fprintf(stderr, "Usage: estimate_legal_big [--target-rse r] <height> <width> <num_samples> <seed> [num_threads]\n");
     return 1;
   }
 
-  height = atoi(argv[1]);
-  width = atoi(argv[2]);
-  num_iterations = atoi(argv[3]);
-  gg_srand(atoi(argv[4]));
+  height = atoi(args[1]);
+  width = atoi(args[2]);
+  num_iterations = atoi(args[3]);
+  seed = atoi(args[4]);
+  if (nargs > 4)
+    num_threads = atoi(args[5]);
+  if (num_threads < 1)
+    num_threads = 1;
   setwidth(height);
+  start = startstate();
 
-  for (j = 0; j < num_iterations; j++) {
-    double p = 1.0;
-    
-    for (k = 0; k < N; k++)
-      memcpy(states[k], *startstate(), sizeof(bstate));
-    
-    for (y = 0; y < width; y++)
-      for (x = 0; x < height; x++) {
-	num_outstates = 0;
-	
-	for (k = 0; k < N; k++) {
-	  bstate expanded_states[3];
-	  int num_expanded_states;
-	  int m;
-	  num_expanded_states = expandstate(states[k], x, expanded_states);
-	  for (m = 0; m < num_expanded_states; m++) {
-	    memcpy(out_states[num_outstates++], expanded_states[m], sizeof(bstate));
-	  }
-	}
-	
-	p *= (double) num_outstates / (3 * N);
-	
-	for (k = 0; k < N; k++)
-	  memcpy(states[k], out_states[random_choice(num_outstates)], sizeof(bstate));
+  estimates = malloc(num_iterations * sizeof(double));
+  thread_rand = malloc(num_threads * sizeof(struct gg_rand_buffer));
+  if (!estimates || !thread_rand) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  for (t = 0; t < num_threads; t++)
+    gg_srand_buffer(&thread_rand[t], seed, t);
+  gg_stats_init(&stats);
+
+  /* With a target relative standard error the replicas run in batches
+   * and the run stops after the first batch that reaches it.
+   */
+  for (batch_begin = 0; batch_begin < num_iterations; batch_begin = batch_end) {
+    batch_end = num_iterations;
+    if (target_rse > 0.0 && batch_begin + num_threads < num_iterations)
+      batch_end = batch_begin + num_threads;
+    run_batch();
+
+    for (j = batch_begin; j < batch_end; j++) {
+      gg_stats_add(&stats, estimates[j]);
+      if ((j + 1) % 10 == 0) {
+	double std = sqrt(stats.m2) / j;
+	printf("%d %10.8lg %lg %lg\n", j + 1, stats.mean,
+	       std, std * sqrt(j));
       }
-    
-    num_legal_final_states = 0;
-    for (k = 0; k < num_outstates; k++)
-      num_legal_final_states += finalstate(out_states[k]);
-    
-    p *= (double) num_legal_final_states / num_outstates;
-    sum_p += p;
-    sum_squared_p += p * p;
-    if ((j + 1) % 10 == 0) {
-      double std = sqrt(sum_squared_p - sum_p * sum_p / (j + 1)) / j;
-      printf("%d %10.8lg %lg %lg\n", j + 1, sum_p / (j + 1),
-	     std, std * sqrt(j));
+    }
+    if (target_rse > 0.0 && gg_stats_reached(&stats, target_rse)) {
+      printf("Reached relative standard error %lg after %ld samples\n",
+	     gg_stats_rse(&stats), stats.n);
+      break;
     }
   }
-      
-  printf("Estimated legal probability: %10.8lg\n", sum_p / num_iterations);
-  printf("Standard deviation: %lg\n",
-	 sqrt(sum_squared_p - sum_p * sum_p / num_iterations) / num_iterations);
+  
+  printf("Estimated legal probability: %10.8lg\n", stats.mean);
+  printf("Standard deviation: %lg\n", sqrt(stats.m2) / stats.n);
   printf("Standard deviation per sample: %lg\n",
-	 sqrt((sum_squared_p - sum_p * sum_p / num_iterations) / num_iterations));
+	 sqrt(gg_stats_variance(&stats)));
   
   return 0;
 }
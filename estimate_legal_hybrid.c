@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "bigstates.h"
+#include "random.h"
+#include "stats.h"
+
+#define DEFAULT_BUDGET 100000
+
+/* Legal probability on boards too wide for exact counting. The first
+ * cells are counted exactly: the weighted distribution of border states
+ * is propagated as in memlegal, merging equal states, until the number
+ * of distinct states exceeds the budget. Every replica then continues
+ * from that exact distribution with stratified sampling as in
+ * estimate_legal_stratified_big.c, starting from one state per stratum
+ * drawn with probability proportional to its weight and carrying the
+ * total weight of the stratum. The first rows, where sampling would
+ * only add noise, contribute none.
+ */
+struct queue_item
+{
+  bstate node;
+  long double weight;
+};
+
+/* Distinct canonical states with their weights, found through an open
+ * addressing hash table of indices.
+ */
+struct layer
+{
+  bstate states;
+  long double *weights;
+  long n;
+  long capacity;
+  long *table;
+  long table_size;
+};
+
+/* Replicas are dealt out round robin to the threads, each drawing from
+ * its own stream of the seed, and summed in replica order at the end.
+ * See estimate_legal.c.
+ */
+static int height;
+static int width;
+static int num_iterations = 10000;
+static int num_threads = 1;
+static unsigned int seed;
+static long budget = DEFAULT_BUDGET;
+static long double *estimates;
+static double target_rse = 0.0;
+static struct gg_rand_buffer *thread_rand;
+static int batch_begin;
+static int batch_end;
+
+/* The exact layer after the first prefix_cells cells. Its states are
+ * grouped by stratum in stratum_order, stratum k taking the entries
+ * from stratum_begin[k] to stratum_begin[k + 1], with the running sum
+ * of their weights in stratum_cumulative.
+ */
+static int prefix_cells;
+static struct layer prefix;
+static long *stratum_order;
+static long *stratum_begin;
+static long double *stratum_cumulative;
+
+static void *
+checked_malloc(size_t size)
+{
+  void *p = malloc(size);
+
+  if (!p) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+static void
+layer_init(struct layer *l)
+{
+  long h;
+
+  l->n = 0;
+  l->capacity = 1024;
+  l->states = checked_malloc(l->capacity * STATEBYTES);
+  l->weights = checked_malloc(l->capacity * sizeof(long double));
+  l->table_size = 2 * l->capacity;
+  l->table = checked_malloc(l->table_size * sizeof(long));
+  for (h = 0; h < l->table_size; h++)
+    l->table[h] = -1;
+}
+
+static void
+layer_free(struct layer *l)
+{
+  free(l->states);
+  free(l->weights);
+  free(l->table);
+}
+
+/* Double the capacity and the table, keeping the load at most 1/2. */
+static void
+layer_grow(struct layer *l)
+{
+  long h, i;
+
+  l->capacity *= 2;
+  l->states = realloc(l->states, l->capacity * STATEBYTES);
+  l->weights = realloc(l->weights, l->capacity * sizeof(long double));
+  free(l->table);
+  l->table_size = 2 * l->capacity;
+  l->table = malloc(l->table_size * sizeof(long));
+  if (!l->states || !l->weights || !l->table) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (h = 0; h < l->table_size; h++)
+    l->table[h] = -1;
+  for (i = 0; i < l->n; i++) {
+    h = hashstate(NTHSTATE(l->states, i)) & (l->table_size - 1);
+    while (l->table[h] >= 0)
+      h = (h + 1) & (l->table_size - 1);
+    l->table[h] = i;
+  }
+}
+
+/* Add weight w to canonical state s. */
+static void
+layer_add(struct layer *l, bstate s, long double w)
+{
+  long h = hashstate(s) & (l->table_size - 1);
+  long i;
+
+  while ((i = l->table[h]) >= 0) {
+    if (!memcmp(NTHSTATE(l->states, i), s, STATEBYTES)) {
+      l->weights[i] += w;
+      return;
+    }
+    h = (h + 1) & (l->table_size - 1);
+  }
+  if (l->n == l->capacity) {
+    layer_grow(l);
+    layer_add(l, s, w);
+    return;
+  }
+  memcpy(NTHSTATE(l->states, l->n), s, STATEBYTES);
+  l->weights[l->n] = w;
+  l->table[h] = l->n++;
+}
+
+/* Propagate the exact distribution from the start state until it holds
+ * more than budget distinct states or the board is complete.
+ */
+static void
+exact_prefix(void)
+{
+  struct layer next;
+  bstate expanded_states = checked_malloc(3 * STATEBYTES);
+  int num_expanded_states;
+  long i;
+  int m;
+
+  layer_init(&prefix);
+  layer_add(&prefix, startstate(), 1.0);
+  for (prefix_cells = 0;
+       prefix_cells < height * width && prefix.n <= budget;
+       prefix_cells++) {
+    layer_init(&next);
+    for (i = 0; i < prefix.n; i++) {
+      num_expanded_states = expandstate(NTHSTATE(prefix.states, i),
+					prefix_cells % height,
+					expanded_states);
+      for (m = 0; m < num_expanded_states; m++) {
+	canonstate(NTHSTATE(expanded_states, m));
+	layer_add(&next, NTHSTATE(expanded_states, m),
+		  prefix.weights[i] / 3.0);
+      }
+    }
+    layer_free(&prefix);
+    prefix = next;
+  }
+  free(expanded_states);
+}
+
+/* Group the prefix states by stratum with a counting sort. */
+static void
+build_strata(void)
+{
+  int *strata = checked_malloc(prefix.n * sizeof(int));
+  long *next = checked_malloc((height + 1) * sizeof(long));
+  long double sum;
+  long i, j;
+  int k;
+
+  stratum_order = checked_malloc(prefix.n * sizeof(long));
+  stratum_begin = checked_malloc((height + 2) * sizeof(long));
+  stratum_cumulative = checked_malloc(prefix.n * sizeof(long double));
+  memset(stratum_begin, 0, (height + 2) * sizeof(long));
+  for (i = 0; i < prefix.n; i++) {
+    strata[i] = stratify(NTHSTATE(prefix.states, i));
+    stratum_begin[strata[i] + 1]++;
+  }
+  for (k = 0; k <= height; k++)
+    stratum_begin[k + 1] += stratum_begin[k];
+  memcpy(next, stratum_begin, (height + 1) * sizeof(long));
+  for (i = 0; i < prefix.n; i++)
+    stratum_order[next[strata[i]]++] = i;
+  for (k = 0; k <= height; k++) {
+    sum = 0.0;
+    for (j = stratum_begin[k]; j < stratum_begin[k + 1]; j++) {
+      sum += prefix.weights[stratum_order[j]];
+      stratum_cumulative[j] = sum;
+    }
+  }
+  free(strata);
+  free(next);
+}
+
+/* Draw the representative of every stratum of the prefix layer. */
+static void
+sample_prefix(struct gg_rand_buffer *rb, struct queue_item *Q)
+{
+  long double u;
+  long lo, hi, mid;
+  int k;
+
+  for (k = 0; k <= height; k++) {
+    lo = stratum_begin[k];
+    hi = stratum_begin[k + 1] - 1;
+    if (hi < lo) {
+      Q[k].weight = -1.0;
+      continue;
+    }
+    Q[k].weight = stratum_cumulative[hi];
+    u = gg_drand_b(rb) * Q[k].weight;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (stratum_cumulative[mid] <= u)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+    Q[k].node = NTHSTATE(prefix.states, stratum_order[lo]);
+  }
+}
+
+/* The rest of the cells as in estimate_legal_stratified_big.c. */
+static long double
+estimate_replica(struct gg_rand_buffer *rb, struct queue_item *Q1,
+		 struct queue_item *Q2, bstate expanded[2])
+{
+  struct queue_item *Qin = Q1;
+  struct queue_item *Qout = Q2;
+  struct queue_item *tmp;
+  bstate out;
+  int cur = 0;
+  long double size = 0.0;
+  int k;
+  int t, x;
+
+  sample_prefix(rb, Qin);
+
+  for (t = prefix_cells; t < height * width; t++) {
+    int num_expanded_states = 0;
+
+    x = t % height;
+    out = expanded[cur];
+    cur ^= 1;
+    for (k = 0; k <= height; k++)
+      Qout[k].weight = -1.0;
+
+    for (k = 0; k <= height; k++) {
+      bstate expanded_states;
+      int num_new_states;
+      int m;
+
+      if (Qin[k].weight == -1.0)
+	continue;
+
+      expanded_states = NTHSTATE(out, num_expanded_states);
+      num_new_states = expandstate(Qin[k].node, x, expanded_states);
+      num_expanded_states += num_new_states;
+      for (m = 0; m < num_new_states; m++) {
+	bstate expanded_state = NTHSTATE(expanded_states, m);
+	int next_stratum = stratify(expanded_state);
+	if (Qout[next_stratum].weight == -1.0) {
+	  Qout[next_stratum].node = expanded_state;
+	  Qout[next_stratum].weight = Qin[k].weight / 3.0;
+	}
+	else {
+	  Qout[next_stratum].weight += Qin[k].weight / 3.0;
+	  if (gg_drand_b(rb) * Qout[next_stratum].weight < Qin[k].weight / 3.0)
+	    Qout[next_stratum].node = expanded_state;
+	}
+      }
+    }
+
+    tmp = Qin;
+    Qin = Qout;
+    Qout = tmp;
+  }
+
+  for (k = 0; k <= height; k++)
+    if (Qin[k].weight != -1.0 && finalstate(Qin[k].node))
+      size += Qin[k].weight;
+
+  return size;
+}
+
+static void *
+worker(void *arg)
+{
+  int thread = (long) arg;
+  struct gg_rand_buffer *rb = &thread_rand[thread];
+  int first = batch_begin + ((thread - batch_begin) % num_threads
+			     + num_threads) % num_threads;
+  struct queue_item *Q1 = checked_malloc((height + 1) * sizeof(struct queue_item));
+  struct queue_item *Q2 = checked_malloc((height + 1) * sizeof(struct queue_item));
+  bstate expanded[2];
+  int j;
+
+  expanded[0] = checked_malloc(3 * (height + 1) * STATEBYTES);
+  expanded[1] = checked_malloc(3 * (height + 1) * STATEBYTES);
+  for (j = first; j < batch_end; j += num_threads)
+    estimates[j] = estimate_replica(rb, Q1, Q2, expanded);
+  free(Q1);
+  free(Q2);
+  free(expanded[0]);
+  free(expanded[1]);
+  return NULL;
+}
+
+/* Run the replicas from batch_begin to batch_end on the threads. */
+static void
+run_batch(void)
+{
+  pthread_t *threads;
+  long t;
+
+  threads = checked_malloc(num_threads * sizeof(pthread_t));
+  for (t = 0; t < num_threads; t++)
+    if (pthread_create(&threads[t], NULL, worker, (void *) t)) {
+      fprintf(stderr, "Cannot create thread %ld\n", t);
+      exit(1);
+    }
+  for (t = 0; t < num_threads; t++)
+    pthread_join(threads[t], NULL);
+  free(threads);
+}
+
+int main(int argc, char **argv)
+{
+  struct gg_stats stats;
+  char **args = argv;
+  int nargs = 0;
+  long double exact = 0.0;
+  long t;
+  int i, j;
+
+  /* Options may appear anywhere, the rest are positional. */
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--budget") && i + 1 < argc)
+      budget = atol(argv[++i]);
+    else if (gg_parse_target_rse(argc, argv, &i, &target_rse))
+      ;
+    else
+      args[++nargs] = argv[i];
+  }
+
+  if (nargs < 4 || budget < 1) {
+    fprintf(stderr, "Usage: estimate_legal_hybrid [--budget n] [--target-rse r] <height> <width> <num_samples> <seed> [num_threads]\n");
+    return 1;
+  }
+
+  height = atoi(args[1]);
+  width = atoi(args[2]);
+  num_iterations = atoi(args[3]);
+  seed = atoi(args[4]);
+  if (nargs > 4)
+    num_threads = atoi(args[5]);
+  if (num_threads < 1)
+    num_threads = 1;
+  setwidth(height);
+
+  exact_prefix();
+  printf("Exact prefix: %d of %d cells, %ld states\n",
+	 prefix_cells, height * width, prefix.n);
+  if (prefix_cells == height * width) {
+    for (t = 0; t < prefix.n; t++)
+      if (finalstate(NTHSTATE(prefix.states, t)))
+	exact += prefix.weights[t];
+    printf("Exact legal probability: %10.8Lg\n", exact);
+    return 0;
+  }
+  build_strata();
+
+  estimates = checked_malloc(num_iterations * sizeof(long double));
+  thread_rand = checked_malloc(num_threads * sizeof(struct gg_rand_buffer));
+  for (t = 0; t < num_threads; t++)
+    gg_srand_buffer(&thread_rand[t], seed, t);
+  gg_stats_init(&stats);
+
+  /* With a target relative standard error the replicas run in batches
+   * and the run stops after the first batch that reaches it.
+   */
+  for (batch_begin = 0; batch_begin < num_iterations; batch_begin = batch_end) {
+    batch_end = num_iterations;
+    if (target_rse > 0.0 && batch_begin + 100 * num_threads < num_iterations)
+      batch_end = batch_begin + 100 * num_threads;
+    run_batch();
+
+    for (j = batch_begin; j < batch_end; j++) {
+      gg_stats_add(&stats, estimates[j]);
+      if ((j + 1) % 1000 == 0) {
+	double std = sqrt(stats.m2) / j;
+	printf("%d %10.8lg %lg %lg\n", j + 1, stats.mean,
+	       std, std * sqrt(j));
+      }
+    }
+    if (target_rse > 0.0 && gg_stats_reached(&stats, target_rse)) {
+      printf("Reached relative standard error %lg after %ld samples\n",
+	     gg_stats_rse(&stats), stats.n);
+      break;
+    }
+  }
+
+  printf("Estimated legal probability: %10.8lg\n", stats.mean);
+  printf("Standard deviation: %lg\n", sqrt(stats.m2) / stats.n);
+  printf("Standard deviation per sample: %lg\n",
+	 sqrt(gg_stats_variance(&stats)));
+
+  return 0;
+}
@@ -2,8 +2,10 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
 #include "states.h"
 #include "random.h"
+#include "stats.h"
 
 #define MAX_HEIGHT 21
 
@@ -15,8 +17,20 @@ struct queue_item
   long double weight;
 };
 
-struct queue_item Q1[MAX_NUMBER_OF_STRATA];
-struct queue_item Q2[MAX_NUMBER_OF_STRATA];
+/* Replicas are dealt out round robin to the threads, each drawing from
+ * its own stream of the seed, and summed in replica order at the end.
+ * See estimate_legal.c.
+ */
+static int height;
+static int width;
+static int num_iterations = 10000;
+static int num_threads = 1;
+static unsigned int seed;
+static long double *estimates;
+static double target_rse = 0.0;
+static struct gg_rand_buffer *thread_rand;
+static int batch_begin;
+static int batch_end;
 
 int compute_stratum(Word_t s)
 {
@@ -34,95 +48,172 @@ int compute_stratum(Word_t s)
     return stratum;
 }
 
-int main(int argc, char **argv)
+static long double
+estimate_replica(struct gg_rand_buffer *rb)
 {
-  int k;
-  int j;
-  long double size = 0.0;
-  long double sum_size = 0.0;
-  long double sum_squared_size = 0.0;
-  int width;
-  int height;
+  struct queue_item Q1[MAX_NUMBER_OF_STRATA];
+  struct queue_item Q2[MAX_NUMBER_OF_STRATA];
   struct queue_item *Qin = Q1;
   struct queue_item *Qout = Q2;
   struct queue_item *tmp;
+  long double size = 0.0;
+  int k;
   int x, y;
-  int num_iterations = 10000;
 
-  if (argc < 5) {
-    fprintf(stderr, "Usage: estimate_legal_stratified <height> <width> <num_samples> <seed>\n");
-    return 1;
-  }
+  for (k = 0; k < MAX_NUMBER_OF_STRATA; k++)
+    Qin[k].weight = -1.0;
 
-  height = atoi(argv[1]);
-  width = atoi(argv[2]);
-  num_iterations = atoi(argv[3]);
-  gg_srand(atoi(argv[4]));
-  setwidth(height);
-  
-  for (j = 0; j < num_iterations; j++) {
-    for (k = 0; k < MAX_NUMBER_OF_STRATA; k++)
-      Qin[k].weight = -1.0;
+  Qin[0].node = STARTSTATE;
+  Qin[0].weight = 1.0;
 
-    Qin[0].node = STARTSTATE;
-    Qin[0].weight = 1.0;
+  for (y = 0; y < width; y++)
+    for (x = 0; x < height; x++) {
 
-    for (y = 0; y < width; y++)
-      for (x = 0; x < height; x++) {
-
-	for (k = 0; k <= 2 * height + 1; k++)
-	  Qout[k].weight = -1.0;
+      for (k = 0; k <= 2 * height + 1; k++)
+	Qout[k].weight = -1.0;
 	
-	for (k = 0; k <= 2 * height + 1; k++) {
-	  Word_t state = Qin[k].node;
-	  Word_t expanded_states[3];
-	  int num_expanded_states;
-	  int m;
+      for (k = 0; k <= 2 * height + 1; k++) {
+	Word_t state = Qin[k].node;
+	Word_t expanded_states[3];
+	int num_expanded_states;
+	int m;
       
-	  if (Qin[k].weight == -1.0)
-	    continue;
+	if (Qin[k].weight == -1.0)
+	  continue;
       
-	  num_expanded_states = expandstate(state, x, expanded_states);
-	  for (m = 0; m < num_expanded_states; m++) {
-	    Word_t next_state = expanded_states[m];
-	    int next_stratum = compute_stratum(next_state);
-	    if (Qout[next_stratum].weight == -1.0) {
+	num_expanded_states = expandstate(state, x, expanded_states);
+	for (m = 0; m < num_expanded_states; m++) {
+	  Word_t next_state = expanded_states[m];
+	  int next_stratum = compute_stratum(next_state);
+	  if (Qout[next_stratum].weight == -1.0) {
+	    Qout[next_stratum].node = next_state;
+	    Qout[next_stratum].weight = Qin[k].weight / 3.0;
+	  }
+	  else {
+	    Qout[next_stratum].weight += Qin[k].weight / 3.0;
+	    if (gg_drand_b(rb) * Qout[next_stratum].weight < Qin[k].weight / 3.0)
 	      Qout[next_stratum].node = next_state;
-	      Qout[next_stratum].weight = Qin[k].weight / 3.0;
-	    }
-	    else {
-	      Qout[next_stratum].weight += Qin[k].weight / 3.0;
-	      if (gg_drand() * Qout[next_stratum].weight < Qin[k].weight / 3.0)
-		Qout[next_stratum].node = next_state;
-	    }
 	  }
 	}
-
-	tmp = Qin;
-	Qin = Qout;
-	Qout = tmp;
       }
 
-    size = 0;
-    for (k = 0; k <= 2 * height + 1; k++)
-      if (Qin[k].weight != -1.0 && finalstate(Qin[k].node))
-	size += Qin[k].weight;
+      tmp = Qin;
+      Qin = Qout;
+      Qout = tmp;
+    }
+
+  for (k = 0; k <= 2 * height + 1; k++)
+    if (Qin[k].weight != -1.0 && finalstate(Qin[k].node))
+      size += Qin[k].weight;
+
+  return size;
+}
+
+static void *
+worker(void *arg)
+{
+  int thread = (long) arg;
+  struct gg_rand_buffer *rb = &thread_rand[thread];
+  int first = batch_begin + ((thread - batch_begin) % num_threads
+			     + num_threads) % num_threads;
+  int j;
+
+  for (j = first; j < batch_end; j += num_threads)
+    estimates[j] = estimate_replica(rb);
+  return NULL;
+}
+
+/* Run the replicas from batch_begin to batch_end on the threads. */
+static void
+run_batch(void)
+{
+  pthread_t *threads;
+  long t;
 
-    sum_size += size;
-    sum_squared_size += size * size;
+  threads = malloc(num_threads * sizeof(pthread_t));
+  if (!threads) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (t = 0; t < num_threads; t++)
+    if (pthread_create(&threads[t], NULL, worker, (void *) t)) {
+      fprintf(stderr, "Cannot create thread %ld\n", t);
+      exit(1);
+    }
+  for (t = 0; t < num_threads; t++)
+    pthread_join(threads[t], NULL);
+  free(threads);
+}
 
-    if ((j + 1) % 1000 == 0) {
-      double std = sqrt(sum_squared_size - sum_size * sum_size / (j + 1)) / j;
-      printf("%d %10.8Lg %lg %lg\n", j + 1, sum_size / (j + 1),
-	     std, std * sqrt(j));
+int main(int argc, char **argv)
+{
+  struct gg_stats stats;
+  char **args = argv;
+  int nargs = 0;
+  long t;
+  int i, j;
+
+  for (i = 1; i < argc; i++)
+    if (!gg_parse_target_rse(argc, argv, &i, &target_rse))
+      args[++nargs] = argv[i];
+
+  if (nargs < 4) {
+    fprintf(stderr, "Usage: estimate_legal_stratified [--target-rse r] <height> <width> <num_samples> <seed> [num_threads]\n");
+    return 1;
+  }
+
+  height = atoi(args[1]);
+  width = atoi(args[2]);
+  num_iterations = atoi(args[3]);
+  seed = atoi(args[4]);
+  if (nargs > 4)
+    num_threads = atoi(args[5]);
+  if (num_threads < 1)
+    num_threads = 1;
+  setwidth(height);
+
+  estimates = malloc(num_iterations * sizeof(long double));
+  thread_rand = malloc(num_threads * sizeof(struct gg_rand_buffer));
+  if (!estimates || !thread_rand) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  for (t = 0; t < num_threads; t++)
+    gg_srand_buffer(&thread_rand[t], seed, t);
+  gg_stats_init(&stats);
+
+  /* With a target relative standard error the replicas run in batches
+   * and the run stops after the first batch that reaches it.
+   */
+  for (batch_begin = 0; batch_begin < num_iterations; batch_begin = batch_end) {
+    batch_end = num_iterations;
+    if (target_rse > 0.0 && batch_begin + 100 * num_threads < num_iterations)
+      batch_end = batch_begin + 100 * num_threads;
+    run_batch();
+
+    for (j = batch_begin; j < batch_end; j++) {
+      /* The estimates are probabilities, summed in long double within a
+       * replica; rounding them to double for the statistics loses far
+       * less than their spread.
+       */
+      gg_stats_add(&stats, (double) estimates[j]);
+      if ((j + 1) % 1000 == 0) {
+	double std = sqrt(stats.m2) / j;
+	printf("%d %10.8lg %lg %lg\n", j + 1, stats.mean,
+	       std, std * sqrt(j));
+      }
+    }
+    if (target_rse > 0.0 && gg_stats_reached(&stats, target_rse)) {
+      printf("Reached relative standard error %lg after %ld samples\n",
+	     gg_stats_rse(&stats), stats.n);
+      break;
     }
   }
   
-  printf("Estimated legal probability: %10.8Lg\n", sum_size / num_iterations);
-  printf("Standard deviation: %lg\n",
-	 sqrt(sum_squared_size - sum_size * sum_size / num_iterations) / num_iterations);
+  printf("Estimated legal probability: %10.8lg\n", stats.mean);
+  printf("Standard deviation: %lg\n", sqrt(stats.m2) / stats.n);
   printf("Standard deviation per sample: %lg\n",
-	 sqrt((sum_squared_size - sum_size * sum_size / num_iterations) / num_iterations));
+	 sqrt(gg_stats_variance(&stats)));
   
   return 0;
 }
@@ -2,12 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include "bigstates.h"
 #include "random.h"
-
-#define MAX_HEIGHT 99
-
-#define MAX_NUMBER_OF_STRATA (2 * MAX_HEIGHT + 1)
+#include "stats.h"
 
 struct queue_item
 {
@@ -15,96 +13,372 @@ struct queue_item
   long double weight;
 };
 
-struct queue_item Q1[MAX_NUMBER_OF_STRATA];
-struct queue_item Q2[MAX_NUMBER_OF_STRATA];
+/* With --per-stratum k > 1 every stratum keeps up to k states. All
+ * states kept after a cell are expanded together, and their successors
+ * collected as candidates and grouped by stratum. A stratum with at
+ * most k candidates keeps them all with their own weights. Otherwise it
+ * keeps k picks, pick j taking the candidate at (j + u_j) / k of the
+ * running weight for a uniform u_j, and every pick carries 1/k of the
+ * total weight of the stratum; a candidate picked more than once is
+ * kept once with the sum. The total weight of every stratum stays exact,
+ * as with one state per stratum, while the picks spread over the
+ * candidates in proportion to their weights.
+ */
+struct candidate
+{
+  bstate node;
+  long double weight;
+  int stratum;
+};
 
-int main(int argc, char **argv)
+static int per_stratum = 1;
+
+/* Replicas are dealt out round robin to the threads, each drawing from
+ * its own stream of the seed, and summed in replica order at the end.
+ * See estimate_legal.c.
+ */
+static int height;
+static int width;
+static int num_iterations = 10000;
+static int num_threads = 1;
+static unsigned int seed;
+static bstate start; /* from startstate(), only read by the threads */
+static long double *estimates;
+static double target_rse = 0.0;
+static struct gg_rand_buffer *thread_rand;
+static int batch_begin;
+static int batch_end;
+
+/* The occupied strata are expanded in place into one of the two
+ * expanded buffers, alternately, and each stratum of the next step only
+ * points at its representative there, so the reservoir choice within a
+ * stratum never copies a state. There are height + 1 strata.
+ */
+static long double
+estimate_replica(struct gg_rand_buffer *rb, struct queue_item *Q1,
+		 struct queue_item *Q2, bstate expanded[2])
 {
-  int k;
-  int j;
-  long double size = 0.0;
-  long double sum_size = 0.0;
-  long double sum_squared_size = 0.0;
-  int width;
-  int height;
   struct queue_item *Qin = Q1;
   struct queue_item *Qout = Q2;
   struct queue_item *tmp;
+  bstate out;
+  int cur = 0;
+  long double size = 0.0;
+  int k;
   int x, y;
-  int num_iterations = 10000;
-
-  if (argc < 5) {
-    fprintf(stderr, "Usage: estimate_legal_stratified <height> <width> <num_samples> <seed>\n");
-    return 1;
-  }
 
-  height = atoi(argv[1]);
-  width = atoi(argv[2]);
-  num_iterations = atoi(argv[3]);
-  gg_srand(atoi(argv[4]));
-  setwidth(height);
-  
-  for (j = 0; j < num_iterations; j++) {
-    for (k = 0; k < MAX_NUMBER_OF_STRATA; k++)
-      Qin[k].weight = -1.0;
+  for (k = 0; k <= height; k++)
+    Qin[k].weight = -1.0;
 
-    memcpy(Qin[0].node, *startstate(), sizeof(bstate));
-    Qin[0].weight = 1.0;
+  Qin[0].node = start;
+  Qin[0].weight = 1.0;
 
-    for (y = 0; y < width; y++)
-      for (x = 0; x < height; x++) {
+  for (y = 0; y < width; y++)
+    for (x = 0; x < height; x++) {
+      int num_expanded_states = 0;
 
-	for (k = 0; k <= height; k++)
-	  Qout[k].weight = -1.0;
+      out = expanded[cur];
+      cur ^= 1;
+      for (k = 0; k <= height; k++)
+	Qout[k].weight = -1.0;
 	
-	for (k = 0; k <= height; k++) {
-	  bstate expanded_states[3];
-	  int num_expanded_states;
-	  int m;
+      for (k = 0; k <= height; k++) {
+	bstate expanded_states;
+	int num_new_states;
+	int m;
       
-	  if (Qin[k].weight == -1.0)
-	    continue;
+	if (Qin[k].weight == -1.0)
+	  continue;
       
-	  num_expanded_states = expandstate(Qin[k].node, x, expanded_states);
-	  for (m = 0; m < num_expanded_states; m++) {
-	    int next_stratum = stratify(expanded_states[m]);
-	    if (Qout[next_stratum].weight == -1.0) {
-	      memcpy(Qout[next_stratum].node, expanded_states[m], sizeof(bstate));
-	      Qout[next_stratum].weight = Qin[k].weight / 3.0;
-	    }
-	    else {
-	      Qout[next_stratum].weight += Qin[k].weight / 3.0;
-	      if (gg_drand() * Qout[next_stratum].weight < Qin[k].weight / 3.0)
-		memcpy(Qout[next_stratum].node, expanded_states[m], sizeof(bstate));
-	    }
+	expanded_states = NTHSTATE(out, num_expanded_states);
+	num_new_states = expandstate(Qin[k].node, x, expanded_states);
+	num_expanded_states += num_new_states;
+	for (m = 0; m < num_new_states; m++) {
+	  bstate expanded_state = NTHSTATE(expanded_states, m);
+	  int next_stratum = stratify(expanded_state);
+	  if (Qout[next_stratum].weight == -1.0) {
+	    Qout[next_stratum].node = expanded_state;
+	    Qout[next_stratum].weight = Qin[k].weight / 3.0;
+	  }
+	  else {
+	    Qout[next_stratum].weight += Qin[k].weight / 3.0;
+	    if (gg_drand_b(rb) * Qout[next_stratum].weight < Qin[k].weight / 3.0)
+	      Qout[next_stratum].node = expanded_state;
 	  }
 	}
+      }
+
+      tmp = Qin;
+      Qin = Qout;
+      Qout = tmp;
+    }
+
+  for (k = 0; k <= height; k++)
+    if (Qin[k].weight != -1.0 && finalstate(Qin[k].node))
+      size += Qin[k].weight;
+
+  return size;
+}
+
+/* Keep per_stratum picks from the n candidates c of one stratum in q. */
+static int
+select_stratum(struct gg_rand_buffer *rb, struct candidate *c, int n,
+	       struct queue_item *q)
+{
+  long double total = 0.0;
+  long double running;
+  long double point;
+  int count = 0;
+  int i, j, last;
+
+  if (n <= per_stratum) {
+    for (i = 0; i < n; i++) {
+      q[i].node = c[i].node;
+      q[i].weight = c[i].weight;
+    }
+    return n;
+  }
+  for (i = 0; i < n; i++)
+    total += c[i].weight;
+  running = c[0].weight;
+  for (i = 0, last = -1, j = 0; j < per_stratum; j++) {
+    point = (j + gg_drand_b(rb)) * total / per_stratum;
+    while (running <= point && i < n - 1)
+      running += c[++i].weight;
+    if (i == last)
+      q[count - 1].weight += total / per_stratum;
+    else {
+      q[count].node = c[i].node;
+      q[count++].weight = total / per_stratum;
+      last = i;
+    }
+  }
+  return count;
+}
+
+/* As estimate_replica() with per_stratum states in each stratum. The
+ * candidates are grouped by stratum with a counting sort from
+ * candidates into sorted.
+ */
+static long double
+estimate_replica_multi(struct gg_rand_buffer *rb, struct queue_item *Q1,
+		       int *count1, struct queue_item *Q2, int *count2,
+		       struct candidate *candidates, struct candidate *sorted,
+		       int *begin, bstate expanded[2])
+{
+  struct queue_item *Qin = Q1;
+  struct queue_item *Qout = Q2;
+  struct queue_item *tmp;
+  int *count_in = count1;
+  int *count_out = count2;
+  int *tmp_count;
+  bstate out;
+  int cur = 0;
+  long double size = 0.0;
+  int i, k;
+  int x, y;
+
+  for (k = 0; k <= height; k++)
+    count_in[k] = 0;
+
+  Qin[0].node = start;
+  Qin[0].weight = 1.0;
+  count_in[0] = 1;
 
-	tmp = Qin;
-	Qin = Qout;
-	Qout = tmp;
+  for (y = 0; y < width; y++)
+    for (x = 0; x < height; x++) {
+      int num_candidates = 0;
+
+      out = expanded[cur];
+      cur ^= 1;
+      for (k = 0; k <= height; k++) {
+	struct queue_item *q = &Qin[k * per_stratum];
+
+	for (i = 0; i < count_in[k]; i++) {
+	  bstate expanded_states = NTHSTATE(out, num_candidates);
+	  int num_new_states = expandstate(q[i].node, x, expanded_states);
+	  int m;
+
+	  for (m = 0; m < num_new_states; m++) {
+	    struct candidate *c = &candidates[num_candidates++];
+	    c->node = NTHSTATE(expanded_states, m);
+	    c->weight = q[i].weight / 3.0;
+	    c->stratum = stratify(c->node);
+	  }
+	}
       }
 
-    size = 0;
-    for (k = 0; k <= height; k++)
-      if (Qin[k].weight != -1.0 && finalstate(Qin[k].node))
-	size += Qin[k].weight;
+      memset(begin, 0, (height + 2) * sizeof(int));
+      for (i = 0; i < num_candidates; i++)
+	begin[candidates[i].stratum + 1]++;
+      for (k = 0; k <= height; k++)
+	begin[k + 1] += begin[k];
+      for (i = 0; i < num_candidates; i++)
+	sorted[begin[candidates[i].stratum]++] = candidates[i];
+      /* Each begin[k] has moved on to the old begin[k + 1]. */
+      for (k = 0; k <= height; k++)
+	count_out[k] = select_stratum(rb, &sorted[k ? begin[k - 1] : 0],
+				      begin[k] - (k ? begin[k - 1] : 0),
+				      &Qout[k * per_stratum]);
+
+      tmp = Qin;
+      Qin = Qout;
+      Qout = tmp;
+      tmp_count = count_in;
+      count_in = count_out;
+      count_out = tmp_count;
+    }
 
-    sum_size += size;
-    sum_squared_size += size * size;
+  for (k = 0; k <= height; k++)
+    for (i = 0; i < count_in[k]; i++)
+      if (finalstate(Qin[k * per_stratum + i].node))
+	size += Qin[k * per_stratum + i].weight;
+
+  return size;
+}
+
+static void *
+worker(void *arg)
+{
+  int thread = (long) arg;
+  struct gg_rand_buffer *rb = &thread_rand[thread];
+  int first = batch_begin + ((thread - batch_begin) % num_threads
+			     + num_threads) % num_threads;
+  int max_states = (height + 1) * per_stratum;
+  struct queue_item *Q1 = malloc(max_states * sizeof(struct queue_item));
+  struct queue_item *Q2 = malloc(max_states * sizeof(struct queue_item));
+  int *count1 = malloc((height + 1) * sizeof(int));
+  int *count2 = malloc((height + 1) * sizeof(int));
+  int *begin = malloc((height + 2) * sizeof(int));
+  struct candidate *candidates = malloc(3 * max_states * sizeof(struct candidate));
+  struct candidate *sorted = malloc(3 * max_states * sizeof(struct candidate));
+  bstate expanded[2];
+  int j;
+
+  expanded[0] = malloc(3 * max_states * STATEBYTES);
+  expanded[1] = malloc(3 * max_states * STATEBYTES);
+  if (!Q1 || !Q2 || !count1 || !count2 || !begin || !candidates || !sorted
+      || !expanded[0] || !expanded[1]) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (j = first; j < batch_end; j += num_threads)
+    if (per_stratum > 1)
+      estimates[j] = estimate_replica_multi(rb, Q1, count1, Q2, count2,
+					    candidates, sorted, begin,
+					    expanded);
+    else
+      estimates[j] = estimate_replica(rb, Q1, Q2, expanded);
+  free(Q1);
+  free(Q2);
+  free(count1);
+  free(count2);
+  free(begin);
+  free(candidates);
+  free(sorted);
+  free(expanded[0]);
+  free(expanded[1]);
+  return NULL;
+}
+
+/* Run the replicas from batch_begin to batch_end on the threads. */
+static void
+run_batch(void)
+{
+  pthread_t *threads;
+  long t;
 
-    if ((j + 1) % 1000 == 0) {
-      double std = sqrt(sum_squared_size - sum_size * sum_size / (j + 1)) / j;
-      printf("%d %10.8Lg %lg %lg\n", j + 1, sum_size / (j + 1),
-	     std, std * sqrt(j));
+  threads = malloc(num_threads * sizeof(pthread_t));
+  if (!threads) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (t = 0; t < num_threads; t++)
+    if (pthread_create(&threads[t], NULL, worker, (void *) t)) {
+      fprintf(stderr, "Cannot create thread %ld\n", t);
+      exit(1);
+    }
+  for (t = 0; t < num_threads; t++)
+    pthread_join(threads[t], NULL);
+  free(threads);
+}
+
+int main(int argc, char **argv)
+{
+  struct gg_stats stats;
+  char **args = argv;
+  int nargs = 0;
+  long t;
+  int i, j;
+
+  /* Options may appear anywhere, the rest are positional. */
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--per-stratum") && i + 1 < argc)
+      per_stratum = atoi(argv[++i]);
+    else if (gg_parse_target_rse(argc, argv, &i, &target_rse))
+      ;
+    else
+      args[++nargs] = argv[i];
+  }
+
+  if (nargs < 4 || per_stratum < 1) {
+    fprintf(stderr, "Usage: estimate_legal_stratified_big [--per-stratum k] [--target-rse r] <height> <width> <num_samples> <seed> [num_threads]\n");
+    return 1;
+  }
+
+  height = atoi(args[1]);
+  width = atoi(args[2]);
+  num_iterations = atoi(args[3]);
+  seed = atoi(args[4]);
+  if (nargs > 4)
+    num_threads = atoi(args[5]);
+  if (num_threads < 1)
+    num_threads = 1;
+  setwidth(height);
+  start = startstate();
+
+  estimates = malloc(num_iterations * sizeof(long double));
+  thread_rand = malloc(num_threads * sizeof(struct gg_rand_buffer));
+  if (!estimates || !thread_rand) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  for (t = 0; t < num_threads; t++)
+    gg_srand_buffer(&thread_rand[t], seed, t);
+  gg_stats_init(&stats);
+
+  /* With a target relative standard error the replicas run in batches
+   * and the run stops after the first batch that reaches it.
+   */
+  for (batch_begin = 0; batch_begin < num_iterations; batch_begin = batch_end) {
+    batch_end = num_iterations;
+    if (target_rse > 0.0 && batch_begin + 100 * num_threads < num_iterations)
+      batch_end = batch_begin + 100 * num_threads;
+    run_batch();
+
+    for (j = batch_begin; j < batch_end; j++) {
+      /* The estimates are probabilities, summed in long double within a
+       * replica; rounding them to double for the statistics loses far
+       * less than their spread.
+       */
+      gg_stats_add(&stats, (double) estimates[j]);
+      if ((j + 1) % 1000 == 0) {
+	double std = sqrt(stats.m2) / j;
+	printf("%d %10.8lg %lg %lg\n", j + 1, stats.mean,
+	       std, std * sqrt(j));
+      }
+    }
+    if (target_rse > 0.0 && gg_stats_reached(&stats, target_rse)) {
+      printf("Reached relative standard error %lg after %ld samples\n",
+	     gg_stats_rse(&stats), stats.n);
+      break;
     }
   }
   
-  printf("Estimated legal probability: %10.8Lg\n", sum_size / num_iterations);
-  printf("Standard deviation: %lg\n",
-	 sqrt(sum_squared_size - sum_size * sum_size / num_iterations) / num_iterations);
+  printf("Estimated legal probability: %10.8lg\n", stats.mean);
+  printf("Standard deviation: %lg\n", sqrt(stats.m2) / stats.n);
   printf("Standard deviation per sample: %lg\n",
-	 sqrt((sum_squared_size - sum_size * sum_size / num_iterations) / num_iterations));
+	 sqrt(gg_stats_variance(&stats)));
   
   return 0;
 }
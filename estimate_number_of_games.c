@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <math.h>
 #include "random.h"
+#include "stats.h"
 
 #if 0
 /* 1x2 */
@@ -115,17 +116,7 @@ int transformations[NUMBER_OF_STATES][2 * NUMBER_OF_POINTS] = {
 };
 #endif
 
-unsigned int random_choice(unsigned int n)
-{
-  unsigned int k;
-  unsigned int r = 0xffffffffU % n;
-
-  do {
-    k = gg_urand();
-  } while (k < r);
-
-  return k % n;
-}
+static struct gg_rand_buffer rb;
 
 void play_games(int state, int *visited_states, double *entropy)
 {
@@ -145,7 +136,7 @@ void play_games(int state, int *visited_states, double *entropy)
   if (number_valid_next_states > 0) {
     (*entropy) += log((double) (number_valid_next_states + 1));
     
-    k = random_choice(number_valid_next_states);
+    k = gg_choice_b(&rb, number_valid_next_states);
     if (k < number_valid_next_states)
       play_games(valid_next_states[k], visited_states, entropy);
   }
@@ -163,13 +154,22 @@ void play_games(int state, int *visited_states, double *entropy)
 
 int main(int argc, char **argv)
 {
-  double entropy = 0.0;
+  double entropy;
+  struct gg_stats stats;
+  double target_rse = 0.0;
   int visited_states[NUMBER_OF_STATES];
+  int i;
   int k;
   int j;
   const int N = 50;
 
-  gg_srand(1);
+  for (i = 1; i < argc; i++)
+    if (!gg_parse_target_rse(argc, argv, &i, &target_rse)) {
+      fprintf(stderr, "Usage: estimate_number_of_games [--target-rse r]\n");
+      return 1;
+    }
+  gg_srand_buffer(&rb, 1, 0);
+  gg_stats_init(&stats);
   
   for (j = 0; j < N; j++) {
     if (j % 100000 == 0)
@@ -177,9 +177,15 @@ int main(int argc, char **argv)
     for (k = 0; k < NUMBER_OF_STATES; k++)
       visited_states[k] = 0;
     
+    entropy = 0.0;
     play_games(0, visited_states, &entropy);
+    gg_stats_add(&stats, entropy);
+    if (target_rse > 0.0 && gg_stats_reached(&stats, target_rse))
+      break;
   }
   
-  printf("Entropy: %f\n", (float) entropy / N / log(2));
+  printf("Entropy: %f\n", (float) stats.mean / log(2));
+  printf("Relative standard error: %g after %ld games\n",
+	 gg_stats_rse(&stats), stats.n);
   return 0;
 }
@@ -119,17 +119,7 @@ double branching_factors_logsum[NUMBER_OF_STATES];
 int branching_factors_num[NUMBER_OF_STATES];
 
 
-unsigned int random_choice(unsigned int n)
-{
-  unsigned int k;
-  unsigned int r = 0xffffffffU % n;
-
-  do {
-    k = gg_urand();
-  } while (k < r);
-
-  return k % n;
-}
+static struct gg_rand_buffer rb;
 
 void play_games(int state, int *visited_states, int depth)
 {
@@ -150,7 +140,7 @@ void play_games(int state, int *visited_states, int depth)
     branching_factors_num[depth]++;
     branching_factors_logsum[depth] += log((double) (number_valid_next_states));
     
-    k = random_choice(number_valid_next_states);
+    k = gg_choice_b(&rb, number_valid_next_states);
     if (k < number_valid_next_states)
       play_games(valid_next_states[k], visited_states, depth + 1);
   }
@@ -166,7 +156,7 @@ int main(int argc, char **argv)
   int j;
   const int N = 100000;
 
-  gg_srand(1);
+  gg_srand_buffer(&rb, 1, 0);
   
   for (k = 0; k < NUMBER_OF_STATES; k++) {
     branching_factors_num[k] = 0;
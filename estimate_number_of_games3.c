@@ -1,6 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include "random.h"
+#include "stats.h"
+#include "gametable.h"
 
 #if 0
 /* 1x2 */
@@ -21284,45 +21287,31 @@ int transformations[NUMBER_OF_STATES][2 * NUMBER_OF_POINTS] = {
 };
 #endif
 
-unsigned int rr[2 * NUMBER_OF_POINTS + 1];
-double logs[2 * NUMBER_OF_POINTS + 1];
+static struct gg_game_table table;
+double *logs;
 int max_depth;
 
-unsigned int random_choice(unsigned int n)
-{
-  unsigned int k;
-#if 0
-  unsigned int r = ((0xffffffffU % n) + 1) % n;
-#else
-  unsigned int r = rr[n];
-#endif
-
-  do {
-    k = gg_urand();
-  } while (k < r);
-
-  return k % n;
-}
+static struct gg_rand_buffer rb;
 
 double play_games(int state, int *visited_states, int depth)
 {
   int k;
-  int valid_next_states[2 * NUMBER_OF_POINTS];
+  uint32_t i;
+  int valid_next_states[table.max_moves];
   unsigned int number_valid_next_states = 0;
   double logsize = 0.0;
   double child_logsize;
   visited_states[state] = 1;
-  for (k = 0; k < 2 * NUMBER_OF_POINTS; k++) {
-    int next_state = transformations[state][k];
-    if (next_state >= 0
-	&& !visited_states[next_state]) {
+  for (i = table.offsets[state]; i < table.offsets[state + 1]; i++) {
+    int next_state = gg_game_table_target(&table, i);
+    if (!visited_states[next_state]) {
       valid_next_states[number_valid_next_states] = next_state;
       number_valid_next_states++;
     }
   }
 
   if (number_valid_next_states > 0) {
-    k = random_choice(number_valid_next_states);
+    k = gg_choice_b(&rb, number_valid_next_states);
     child_logsize = play_games(valid_next_states[k], visited_states, depth + 1);
 #if 0
     logsize = child_logsize + log((double) (number_valid_next_states));
@@ -21341,19 +21330,31 @@ double play_games(int state, int *visited_states, int depth)
 int main(int argc, char **argv)
 {
   double logsize;
-  int visited_states[NUMBER_OF_STATES];
+  int *visited_states;
   int k;
   int j;
   const int N = 1000000000;
-  double logsum = 0.0;
+  struct gg_log_stats stats;
+  double target_rse = 0.0;
+  int i;
 
-  gg_srand(6);
+  table.offsets = NULL;
+  for (i = 1; i < argc; i++)
+    if (!gg_parse_target_rse(argc, argv, &i, &target_rse)
+	&& !gg_parse_game_table(argc, argv, &i, &table)) {
+      fprintf(stderr, "Usage: estimate_number_of_games3 [--target-rse r] [--table file]\n");
+      return 1;
+    }
+  if (!table.offsets)
+    gg_game_table_from_array(&table, &transformations[0][0],
+			     NUMBER_OF_STATES, NUMBER_OF_POINTS);
+  gg_srand_buffer(&rb, 6, 0);
+  gg_log_stats_init(&stats);
   
-  for (k = 0; k < NUMBER_OF_STATES; k++)
-    visited_states[k] = 0;
+  visited_states = calloc(table.number_of_states, sizeof(int));
+  logs = malloc((table.max_moves + 1) * sizeof(double));
 
-  for (k = 1; k <= 2 * NUMBER_OF_POINTS; k++) {
-    rr[k] = ((0xffffffffU % k) + 1) % k;
+  for (k = 1; k <= table.max_moves; k++) {
     logs[k] = log((double) k);
   }
 
@@ -21361,17 +21362,18 @@ int main(int argc, char **argv)
   
   for (j = 0; j < N; j++) {
     if (j % 1000000 == 999999)
-      printf("%d %f (max_depth: %d)\n", j, (float) (logsum - log(j)) / log(2),
-	     max_depth);
+      printf("%d %f (max_depth: %d)\n", j,
+	     (float) gg_log_stats_log_mean(&stats) / log(2), max_depth);
 
     logsize = play_games(0, visited_states, 1);
-    if (logsize < logsum)
-      logsum += log(1 + exp(logsize - logsum));
-    else
-      logsum = logsize + log(1 + exp(logsum - logsize));
+    gg_log_stats_add(&stats, logsize);
+    if (target_rse > 0.0 && gg_log_stats_reached(&stats, target_rse))
+      break;
   }
   
-  printf("Logsize: %f, max_depth: %d\n", (float) (logsum - log(N)) / log(2),
-	 max_depth);
+  printf("Logsize: %f, max_depth: %d\n",
+	 (float) gg_log_stats_log_mean(&stats) / log(2), max_depth);
+  printf("Relative standard error: %g after %ld games\n",
+	 gg_log_stats_rse(&stats), stats.n);
   return 0;
 }
@@ -1,7 +1,10 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include <assert.h>
 #include "random.h"
+#include "stats.h"
+#include "gametable.h"
 
 #if 0
 /* 1x2 */
@@ -21292,29 +21295,31 @@ struct queue_item
   long double weight;
 };
 
-struct queue_item Q[NUMBER_OF_STATES];
-long double sum_weights[NUMBER_OF_STATES];
+static struct gg_game_table table;
+struct queue_item *Q;
+long double *sum_weights;
 
-int compute_stratum(int node, int visited_states[NUMBER_OF_STATES])
+int compute_stratum(int node, int *visited_states)
 {
-  static long marks[NUMBER_OF_STATES];
+  static long *marks;
   static long mark = 0;
-  int stack[NUMBER_OF_STATES];
+  int stack[table.number_of_states];
   int stackp = 0;
   int size = -1;
 
+  if (!marks)
+    marks = calloc(table.number_of_states, sizeof(long));
   mark++;
   
   stack[stackp++] = node;
   marks[node] = mark;
   while (stackp > 0) {
     int state = stack[--stackp];
-    int s;
+    uint32_t s;
     size++;
-    for (s = 0; s < 2 * NUMBER_OF_POINTS; s++) {
-      int next_state = transformations[state][s];
-      if (next_state >= 0
-	  && !visited_states[next_state]
+    for (s = table.offsets[state]; s < table.offsets[state + 1]; s++) {
+      int next_state = gg_game_table_target(&table, s);
+      if (!visited_states[next_state]
 	  && marks[next_state] != mark) {
 	stack[stackp++] = next_state;
 	marks[next_state] = mark;
@@ -21322,37 +21327,55 @@ int compute_stratum(int node, int visited_states[NUMBER_OF_STATES])
     }
   }
 
-  assert(size >= 0 && size < NUMBER_OF_STATES);
+  assert(size >= 0 && size < table.number_of_states);
   return size;
 }
 
+static struct gg_rand_buffer rb;
+
 int main(int argc, char **argv)
 {
-  int visited_states[NUMBER_OF_STATES];
+  int *visited_states;
   int k;
   int j;
   const int N = 200;
   long double size;
+  long double sample;
+  struct gg_log_stats stats;
+  double target_rse = 0.0;
+  int i;
 
-  gg_srand(4);
+  table.offsets = NULL;
+  for (i = 1; i < argc; i++)
+    if (!gg_parse_target_rse(argc, argv, &i, &target_rse)
+	&& !gg_parse_game_table(argc, argv, &i, &table)) {
+      fprintf(stderr, "Usage: estimate_number_of_games_stratified [--target-rse r] [--table file]\n");
+      return 1;
+    }
+  if (!table.offsets)
+    gg_game_table_from_array(&table, &transformations[0][0],
+			     NUMBER_OF_STATES, NUMBER_OF_POINTS);
+  gg_srand_buffer(&rb, 4, 0);
+  gg_log_stats_init(&stats);
 
-  for (k = 0; k < NUMBER_OF_STATES; k++) {
-    visited_states[k] = 0;
-    sum_weights[k] = 0.0;
-  }
+  visited_states = calloc(table.number_of_states, sizeof(int));
+  Q = malloc(table.number_of_states * sizeof(struct queue_item));
+  sum_weights = calloc(table.number_of_states, sizeof(long double));
   
   for (j = 0; j < N; j++) {
     printf("%d ", j);
-    for (k = 0; k < NUMBER_OF_STATES; k++)
+    sample = 0.0;
+    for (k = 0; k < table.number_of_states; k++)
       Q[k].node = -1;
 
-    Q[NUMBER_OF_STATES - 1].node = 0;
-    Q[NUMBER_OF_STATES - 1].parent_stratum = -1;
-    Q[NUMBER_OF_STATES - 1].weight = 1.0;
+    Q[table.number_of_states - 1].node = 0;
+    Q[table.number_of_states - 1].parent_stratum = -1;
+    Q[table.number_of_states - 1].weight = 1.0;
 
     size = 0.0;
-    for (k = NUMBER_OF_STATES - 1; k >= 0; k--) {
-      int r, s;
+    for (k = table.number_of_states - 1; k >= 0; k--) {
+      int r;
+      uint32_t s;
       int state = Q[k].node;
       
       if (state == -1)
@@ -21360,15 +21383,15 @@ int main(int argc, char **argv)
       
       sum_weights[k] += Q[k].weight;
       size += Q[k].weight;
+      sample += Q[k].weight;
       
       for (r = k; r >= 0; r = Q[r].parent_stratum) {
 	visited_states[Q[r].node] = 1;
       }
      
-      for (s = 0; s < 2 * NUMBER_OF_POINTS; s++) {
-	int next_state = transformations[state][s];
-	if (next_state >= 0
-	    && !visited_states[next_state]) {
+      for (s = table.offsets[state]; s < table.offsets[state + 1]; s++) {
+	int next_state = gg_game_table_target(&table, s);
+	if (!visited_states[next_state]) {
 	  int next_stratum = compute_stratum(next_state, visited_states);
 	  if (Q[next_stratum].node == -1) {
 	    Q[next_stratum].node = next_state;
@@ -21377,7 +21400,7 @@ int main(int argc, char **argv)
 	  }
 	  else {
 	    Q[next_stratum].weight += Q[k].weight;
-	    if (gg_drand() * Q[next_stratum].weight < Q[k].weight) {
+	    if (gg_drand_b(&rb) * Q[next_stratum].weight < Q[k].weight) {
 	      Q[next_stratum].node = next_state;
 	      Q[next_stratum].parent_stratum = k;
 	    }
@@ -21389,17 +21412,22 @@ int main(int argc, char **argv)
 	visited_states[Q[r].node] = 0;
     }
     printf("%Lg\n", size);
+    gg_log_stats_add(&stats, (double) logl(sample));
+    if (target_rse > 0.0 && gg_log_stats_reached(&stats, target_rse))
+      break;
   }
 
   size = 0.0;
-  for (k = NUMBER_OF_STATES - 1; k >= 0; k--) {
+  for (k = table.number_of_states - 1; k >= 0; k--) {
     size += sum_weights[k];
 #if 0
-    printf("%d %Lg %Lg\n", k, sum_weights[k] / N, size / N);
+    printf("%d %Lg %Lg\n", k, sum_weights[k] / stats.n, size / stats.n);
 #endif
   }
 
-  printf("Estimated size: %Lg\n%Lf\n", size / N, size / N);
+  printf("Estimated size: %Lg\n%Lf\n", size / stats.n, size / stats.n);
+  printf("Relative standard error: %g after %ld iterations\n",
+	 gg_log_stats_rse(&stats), stats.n);
 
   return 0;
 }
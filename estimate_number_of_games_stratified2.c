@@ -1,7 +1,11 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 #include "random.h"
+#include "stats.h"
+#include "gametable.h"
 
 #if 0
 /* 1x2 */
@@ -21292,14 +21296,48 @@ struct queue_item
   long double weight;
 };
 
-struct queue_item Q[2 * NUMBER_OF_POINTS * NUMBER_OF_STATES];
-long double sum_weights[2 * NUMBER_OF_POINTS * NUMBER_OF_STATES];
+static struct gg_game_table table;
+static int number_of_strata;
+struct queue_item *Q;
+long double *sum_weights;
 
-int compute_stratum(int node, int visited_states[NUMBER_OF_STATES])
+/* With --per-stratum k > 1 every stratum keeps up to k nodes instead of
+ * the single Q[stratum]. The children offered to a stratum are kept as
+ * arrivals on a list per stratum until the stratum comes up. If there
+ * are at most k they are all kept with their own weights, otherwise k
+ * picks are drawn in proportion to weight, pick j at (j + u_j) / k of
+ * the running weight, each carrying 1/k of the total weight, and a node
+ * picked more than once is kept once with the sum. As with one node per
+ * stratum the total weight reaching every stratum is kept exactly. The
+ * kept nodes of an iteration are appended to kept[], where parent
+ * indexes the kept parent.
+ */
+struct arrival
+{
+  int node;
+  int parent;
+  long double weight;
+  int next;
+};
+
+static int per_stratum = 1;
+static struct queue_item *kept;
+static int kept_size;
+static struct arrival *arrivals;
+static int arrivals_size;
+static int *heads;
+static struct queue_item *candidates;
+static int candidates_size;
+
+/* Work space of compute_stratum(), one entry per state, allocated in
+ * main(). Every state is pushed at most once per call.
+ */
+static long *marks;
+static int *stack;
+
+int compute_stratum(int node, int *visited_states)
 {
-  static long marks[NUMBER_OF_STATES];
   static long mark = 0;
-  int stack[NUMBER_OF_STATES];
   int stackp = 0;
   int size = -1;
 
@@ -21309,12 +21347,11 @@ int compute_stratum(int node, int visited_states[NUMBER_OF_STATES])
   marks[node] = mark;
   while (stackp > 0) {
     int state = stack[--stackp];
-    int s;
+    uint32_t s;
     size++;
-    for (s = 0; s < 2 * NUMBER_OF_POINTS; s++) {
-      int next_state = transformations[state][s];
-      if (next_state >= 0
-	  && !visited_states[next_state]
+    for (s = table.offsets[state]; s < table.offsets[state + 1]; s++) {
+      int next_state = gg_game_table_target(&table, s);
+      if (!visited_states[next_state]
 	  && next_state != node) {
 	size++;
 	if (marks[next_state] != mark) {
@@ -21325,91 +21362,255 @@ int compute_stratum(int node, int visited_states[NUMBER_OF_STATES])
     }
   }
 
-  assert(size >= 0 && size < 2 * NUMBER_OF_POINTS * NUMBER_OF_STATES);
+  assert(size >= 0 && size < number_of_strata);
   return size;
 }
 
+static struct gg_rand_buffer rb;
+
+static void *
+grow(void *p, int *size, int needed, size_t item_size)
+{
+  if (needed <= *size)
+    return p;
+  while (*size < needed)
+    *size = *size ? 2 * *size : 1024;
+  p = realloc(p, *size * item_size);
+  if (!p) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+/* One iteration with one node per stratum, returning the sample and
+ * adding to sum_weights.
+ */
+static long double
+sample_tree(int first_stratum, int *visited_states)
+{
+  long double sample;
+  int k;
+
+  sample = 0.0;
+  for (k = 0; k < number_of_strata; k++)
+    Q[k].node = -1;
+
+  Q[first_stratum].node = 0;
+  Q[first_stratum].parent_stratum = -1;
+  Q[first_stratum].weight = 1.0;
+
+  for (k = first_stratum; k >= 0; k--) {
+    int r;
+    uint32_t s;
+    int state = Q[k].node;
+    
+    if (state == -1)
+      continue;
+    
+    sum_weights[k] += Q[k].weight;
+    sample += Q[k].weight;
+    
+    for (r = k; r >= 0; r = Q[r].parent_stratum) {
+      visited_states[Q[r].node] = 1;
+    }
+   
+    for (s = table.offsets[state]; s < table.offsets[state + 1]; s++) {
+      int next_state = gg_game_table_target(&table, s);
+      if (!visited_states[next_state]) {
+	int next_stratum = compute_stratum(next_state, visited_states);
+	if (Q[next_stratum].node == -1) {
+	  Q[next_stratum].node = next_state;
+	  Q[next_stratum].parent_stratum = k;
+	  Q[next_stratum].weight = Q[k].weight;
+	}
+	else {
+	  Q[next_stratum].weight += Q[k].weight;
+	  if (gg_drand_b(&rb) * Q[next_stratum].weight < Q[k].weight) {
+	    Q[next_stratum].node = next_state;
+	    Q[next_stratum].parent_stratum = k;
+	  }
+	}
+      }
+    }
+    
+    for (r = k; r >= 0; r = Q[r].parent_stratum)
+      visited_states[Q[r].node] = 0;
+  }
+  return sample;
+}
+
+/* Keep per_stratum picks from the n candidates c in q. */
+static int
+select_stratum(struct queue_item *c, int n, struct queue_item *q)
+{
+  long double total = 0.0;
+  long double running;
+  long double point;
+  int count = 0;
+  int i, j, last;
+
+  if (n <= per_stratum) {
+    memcpy(q, c, n * sizeof(struct queue_item));
+    return n;
+  }
+  for (i = 0; i < n; i++)
+    total += c[i].weight;
+  running = c[0].weight;
+  for (i = 0, last = -1, j = 0; j < per_stratum; j++) {
+    point = (j + gg_drand_b(&rb)) * total / per_stratum;
+    while (running <= point && i < n - 1)
+      running += c[++i].weight;
+    if (i == last)
+      q[count - 1].weight += total / per_stratum;
+    else {
+      q[count] = c[i];
+      q[count++].weight = total / per_stratum;
+      last = i;
+    }
+  }
+  return count;
+}
+
+/* One iteration with per_stratum nodes per stratum, returning the
+ * sample and adding to sum_weights.
+ */
+static long double
+sample_tree_multi(int first_stratum, int *visited_states)
+{
+  long double sample = 0.0;
+  int num_kept = 0;
+  int num_arrivals = 1;
+  int k;
+
+  for (k = 0; k <= first_stratum; k++)
+    heads[k] = -1;
+  arrivals[0].node = 0;
+  arrivals[0].parent = -1;
+  arrivals[0].weight = 1.0;
+  arrivals[0].next = -1;
+  heads[first_stratum] = 0;
+
+  for (k = first_stratum; k >= 0; k--) {
+    int first_kept = num_kept;
+    int n = 0;
+    int a, i, r;
+    uint32_t s;
+
+    candidates = grow(candidates, &candidates_size, num_arrivals,
+		      sizeof(struct queue_item));
+    for (a = heads[k]; a >= 0; a = arrivals[a].next) {
+      candidates[n].node = arrivals[a].node;
+      candidates[n].parent_stratum = arrivals[a].parent;
+      candidates[n++].weight = arrivals[a].weight;
+    }
+    if (!n)
+      continue;
+    kept = grow(kept, &kept_size, num_kept + per_stratum,
+		sizeof(struct queue_item));
+    num_kept += select_stratum(candidates, n, &kept[num_kept]);
+
+    for (i = first_kept; i < num_kept; i++) {
+      int state = kept[i].node;
+
+      sum_weights[k] += kept[i].weight;
+      sample += kept[i].weight;
+
+      for (r = i; r >= 0; r = kept[r].parent_stratum)
+	visited_states[kept[r].node] = 1;
+
+      arrivals = grow(arrivals, &arrivals_size,
+		      num_arrivals + table.max_moves,
+		      sizeof(struct arrival));
+      for (s = table.offsets[state]; s < table.offsets[state + 1]; s++) {
+	int next_state = gg_game_table_target(&table, s);
+	if (!visited_states[next_state]) {
+	  int next_stratum = compute_stratum(next_state, visited_states);
+	  arrivals[num_arrivals].node = next_state;
+	  arrivals[num_arrivals].parent = i;
+	  arrivals[num_arrivals].weight = kept[i].weight;
+	  arrivals[num_arrivals].next = heads[next_stratum];
+	  heads[next_stratum] = num_arrivals++;
+	}
+      }
+
+      for (r = i; r >= 0; r = kept[r].parent_stratum)
+	visited_states[kept[r].node] = 0;
+    }
+  }
+  return sample;
+}
+
 int main(int argc, char **argv)
 {
-  int visited_states[NUMBER_OF_STATES];
+  int *visited_states;
   int k;
   int j;
   const int N = 2000000;
   long double size;
+  long double sample;
+  struct gg_log_stats stats;
+  double target_rse = 0.0;
+  int i;
   int first_stratum;
 
-  gg_srand(4);
-
-  for (k = 0; k < 2 * NUMBER_OF_POINTS * NUMBER_OF_STATES; k++) {
-    sum_weights[k] = 0.0;
+  table.offsets = NULL;
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--per-stratum") && i + 1 < argc)
+      per_stratum = atoi(argv[++i]);
+    else if (!gg_parse_target_rse(argc, argv, &i, &target_rse)
+	     && !gg_parse_game_table(argc, argv, &i, &table))
+      break;
   }
-
-  for (k = 0; k < NUMBER_OF_STATES; k++) {
-    visited_states[k] = 0;
+  if (i < argc || per_stratum < 1) {
+    fprintf(stderr, "Usage: estimate_number_of_games_stratified2 [--per-stratum k] [--target-rse r] [--table file]\n");
+    return 1;
   }
+  if (!table.offsets)
+    gg_game_table_from_array(&table, &transformations[0][0],
+			     NUMBER_OF_STATES, NUMBER_OF_POINTS);
+  gg_srand_buffer(&rb, 4, 0);
+  arrivals = grow(NULL, &arrivals_size, 1, sizeof(struct arrival));
+  gg_log_stats_init(&stats);
+
+  number_of_strata = 2 * table.number_of_points * table.number_of_states;
+  Q = malloc(number_of_strata * sizeof(struct queue_item));
+  sum_weights = calloc(number_of_strata, sizeof(long double));
+  heads = malloc(number_of_strata * sizeof(int));
+  visited_states = calloc(table.number_of_states, sizeof(int));
+  marks = calloc(table.number_of_states, sizeof(long));
+  stack = malloc(table.number_of_states * sizeof(int));
 
   first_stratum = compute_stratum(0, visited_states);
   printf("First stratum: %d\n", first_stratum);
   
     size = 0.0;
   for (j = 0; j < N; j++) {
-    for (k = 0; k < 2 * NUMBER_OF_POINTS * NUMBER_OF_STATES; k++)
-      Q[k].node = -1;
-
-    Q[first_stratum].node = 0;
-    Q[first_stratum].parent_stratum = -1;
-    Q[first_stratum].weight = 1.0;
-
-    for (k = first_stratum; k >= 0; k--) {
-      int r, s;
-      int state = Q[k].node;
-      
-      if (state == -1)
-	continue;
-      
-      sum_weights[k] += Q[k].weight;
-      size += Q[k].weight;
-      
-      for (r = k; r >= 0; r = Q[r].parent_stratum) {
-	visited_states[Q[r].node] = 1;
-      }
-     
-      for (s = 0; s < 2 * NUMBER_OF_POINTS; s++) {
-	int next_state = transformations[state][s];
-	if (next_state >= 0
-	    && !visited_states[next_state]) {
-	  int next_stratum = compute_stratum(next_state, visited_states);
-	  if (Q[next_stratum].node == -1) {
-	    Q[next_stratum].node = next_state;
-	    Q[next_stratum].parent_stratum = k;
-	    Q[next_stratum].weight = Q[k].weight;
-	  }
-	  else {
-	    Q[next_stratum].weight += Q[k].weight;
-	    if (gg_drand() * Q[next_stratum].weight < Q[k].weight) {
-	      Q[next_stratum].node = next_state;
-	      Q[next_stratum].parent_stratum = k;
-	    }
-	  }
-	}
-      }
-      
-      for (r = k; r >= 0; r = Q[r].parent_stratum)
-	visited_states[Q[r].node] = 0;
-    }
+    if (per_stratum > 1)
+      sample = sample_tree_multi(first_stratum, visited_states);
+    else
+      sample = sample_tree(first_stratum, visited_states);
+    size += sample;
    if ((j+1) % 1000 == 0)
       printf("%d %Lg\n", j+1, size / (j+1));
+    gg_log_stats_add(&stats, (double) logl(sample));
+    if (target_rse > 0.0 && gg_log_stats_reached(&stats, target_rse))
+      break;
   }
 
   size = 0.0;
-  for (k = 2 * NUMBER_OF_POINTS * NUMBER_OF_STATES - 1; k >= 0; k--) {
+  for (k = number_of_strata - 1; k >= 0; k--) {
     size += sum_weights[k];
 #if 0
-    printf("%d %Lg %Lg\n", k, sum_weights[k] / N, size / N);
+    printf("%d %Lg %Lg\n", k, sum_weights[k] / stats.n, size / stats.n);
 #endif
   }
 
-  printf("Estimated size: %Lg\n%Lf\n", size / N, size / N);
+  printf("Estimated size: %Lg\n%Lf\n", size / stats.n, size / stats.n);
+  printf("Relative standard error: %g after %ld iterations\n",
+	 gg_log_stats_rse(&stats), stats.n);
 
+  free(marks);
+  free(stack);
   return 0;
 }
@@ -1,8 +1,11 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include <string.h>
 #include <float.h>
 #include "random.h"
+#include "stats.h"
+#include "gametable.h"
 
 #if 0
 /* 1x2 */
@@ -21286,12 +21289,12 @@ int transformations[NUMBER_OF_STATES][2 * NUMBER_OF_POINTS] = {
 };
 #endif
 
-unsigned int rr[2 * NUMBER_OF_POINTS + 1];
-double logs[2 * NUMBER_OF_POINTS + 1];
+static struct gg_game_table table;
+double *logs;
 int max_depth;
-unsigned int depth_stats[NUMBER_OF_STATES + 1];
-int path[NUMBER_OF_STATES + 1];
-int best_path[NUMBER_OF_STATES + 1];
+unsigned int *depth_stats;
+int *path;
+int *best_path;
 
 enum uct_node_state {NEW, FULLY_EXPANDED, SOLVED};
 
@@ -21324,24 +21327,15 @@ unsigned int get_new_node(struct uct_tree *tree)
   return tree->next_node++;
 }
 
-unsigned int random_choice(unsigned int n)
-{
-  unsigned int k;
-  unsigned int r = rr[n];
-
-  do {
-    k = gg_urand();
-  } while (k < r);
-
-  return k % n;
-}
+static struct gg_rand_buffer rb;
 
 double play_games(int state, int *visited_states, int depth,
 		  struct uct_tree * tree, struct uct_node *node,
 		  int *length)
 {
   int k;
-  int valid_next_states[2 * NUMBER_OF_POINTS];
+  uint32_t i;
+  int valid_next_states[table.max_moves];
   unsigned int number_valid_next_states = 0;
   double logsize = 0.0;
   double child_logsize;
@@ -21350,10 +21344,8 @@ double play_games(int state, int *visited_states, int depth,
   
   visited_states[state] = 1;
   path[depth] = state;
-  for (k = 0; k < 2 * NUMBER_OF_POINTS; k++) {
-    next_state = transformations[state][k];
-    if (next_state < 0)
-      break;
+  for (i = table.offsets[state]; i < table.offsets[state + 1]; i++) {
+    next_state = gg_game_table_target(&table, i);
     if (!visited_states[next_state]) {
       valid_next_states[number_valid_next_states] = next_state;
       number_valid_next_states++;
@@ -21362,7 +21354,7 @@ double play_games(int state, int *visited_states, int depth,
 
   if (number_valid_next_states > 0) {
     if (!node || node->n == 0) {
-      k = random_choice(number_valid_next_states);
+      k = gg_choice_b(&rb, number_valid_next_states);
       next_state = valid_next_states[k];
       next_node = NULL;
     }
@@ -21435,7 +21427,7 @@ double play_games(int state, int *visited_states, int depth,
   else {
     if (depth > max_depth) {
       max_depth = depth;
-      memcpy(best_path, path, sizeof(path));
+      memcpy(best_path, path, (table.number_of_states + 1) * sizeof(int));
     }
     *length = depth;
     depth_stats[depth]++;
@@ -21448,23 +21440,38 @@ double play_games(int state, int *visited_states, int depth,
 int main(int argc, char **argv)
 {
   double logsize;
-  int visited_states[NUMBER_OF_STATES];
+  int *visited_states;
   int k;
   int j;
   const int N = 10000000;
-  double logsum = 0.0;
+  struct gg_log_stats stats;
+  double target_rse = 0.0;
+  int i;
   int length;
   long double number_of_games = 0;
 
   struct uct_tree *tree = &global_tree;
 
-  gg_srand(6);
+  table.offsets = NULL;
+  for (i = 1; i < argc; i++)
+    if (!gg_parse_target_rse(argc, argv, &i, &target_rse)
+	&& !gg_parse_game_table(argc, argv, &i, &table)) {
+      fprintf(stderr, "Usage: estimate_number_of_games_uct [--target-rse r] [--table file]\n");
+      return 1;
+    }
+  if (!table.offsets)
+    gg_game_table_from_array(&table, &transformations[0][0],
+			     NUMBER_OF_STATES, NUMBER_OF_POINTS);
+  gg_srand_buffer(&rb, 6, 0);
+  gg_log_stats_init(&stats);
 
-  for (k = 0; k < NUMBER_OF_STATES; k++)
-    visited_states[k] = 0;
+  visited_states = calloc(table.number_of_states, sizeof(int));
+  depth_stats = calloc(table.number_of_states + 1, sizeof(unsigned int));
+  path = calloc(table.number_of_states + 1, sizeof(int));
+  best_path = calloc(table.number_of_states + 1, sizeof(int));
+  logs = malloc((table.max_moves + 1) * sizeof(double));
 
-  for (k = 1; k <= 2 * NUMBER_OF_POINTS; k++) {
-    rr[k] = ((0xffffffffU % k) + 1) % k;
+  for (k = 1; k <= table.max_moves; k++) {
     logs[k] = log((double) k);
   }
 
@@ -21475,16 +21482,15 @@ int main(int argc, char **argv)
   
   for (j = 0; j < N; j++) {
     logsize = play_games(0, visited_states, 1, tree, tree->nodes, &length);
-    if (logsize < logsum)
-      logsum += log(1 + exp(logsize - logsum));
-    else
-      logsum = logsize + log(1 + exp(logsum - logsize));
+    gg_log_stats_add(&stats, logsize);
     
     if (j % 10000 == 9999) {
       printf("%d %f (max_depth: %d)\n", j + 1,
-	     (float) (logsum - log(j + 1)) / log(2), max_depth);
+	     (float) gg_log_stats_log_mean(&stats) / log(2), max_depth);
       fflush(stdout);
     }
+    if (target_rse > 0.0 && gg_log_stats_reached(&stats, target_rse))
+      break;
   }
 
   printf("Game length distribution:\n");
@@ -21509,8 +21515,10 @@ int main(int argc, char **argv)
     }
   }
 
-  printf("\nLogsize: %f, max_depth: %d\n", (float) (logsum - log(N)) / log(2),
-	 max_depth);
+  printf("\nLogsize: %f, max_depth: %d\n",
+	 (float) gg_log_stats_log_mean(&stats) / log(2), max_depth);
+  printf("Relative standard error: %g after %ld games\n",
+	 gg_log_stats_rse(&stats), stats.n);
   printf("\nNumber of games: %Lf %Lg, max_depth: %d\n", number_of_games,
 	 number_of_games, max_depth);
   return 0;
@@ -0,0 +1,214 @@
+/* gametable.c - Transition tables of the game tree programs, see
+ * gametable.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gametable.h"
+
+
+/* Fill in max_moves and check that the rows and targets are in range. */
+static int
+check_table(struct gg_game_table *table)
+{
+  int s;
+  int i;
+
+  table->max_moves = 0;
+  if (table->offsets[0] != 0
+      || table->offsets[table->number_of_states] != table->number_of_moves)
+    return 0;
+  for (s = 0; s < table->number_of_states; s++) {
+    int n = (int) (table->offsets[s + 1] - table->offsets[s]);
+    if (n < 0 || n > 2 * table->number_of_points)
+      return 0;
+    if (n > table->max_moves)
+      table->max_moves = n;
+  }
+  for (i = 0; i < table->number_of_moves; i++)
+    if (gg_game_table_target(table, i) >= table->number_of_states)
+      return 0;
+  return 1;
+}
+
+
+int
+gg_game_table_load(struct gg_game_table *table, const char *filename)
+{
+  struct gg_game_table_header header;
+  struct stat st;
+  size_t size;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    perror(filename);
+    if (fd >= 0)
+      close(fd);
+    return 0;
+  }
+  if ((size_t) st.st_size < sizeof(header)
+      || pread(fd, &header, sizeof(header), 0) != sizeof(header)
+      || memcmp(header.magic, GG_GAME_TABLE_MAGIC, sizeof(header.magic))
+      || (header.target_bytes != 2 && header.target_bytes != 4)
+      || header.number_of_states == 0) {
+    fprintf(stderr, "%s: not a game table\n", filename);
+    close(fd);
+    return 0;
+  }
+  size = (sizeof(header)
+	  + (header.number_of_states + 1L) * sizeof(uint32_t)
+	  + (size_t) header.number_of_moves * header.target_bytes);
+  if ((size_t) st.st_size != size) {
+    fprintf(stderr, "%s: truncated game table\n", filename);
+    close(fd);
+    return 0;
+  }
+
+  table->map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (table->map == MAP_FAILED) {
+    perror(filename);
+    return 0;
+  }
+  table->map_size = size;
+  table->number_of_states = header.number_of_states;
+  table->number_of_points = header.number_of_points;
+  table->number_of_moves = header.number_of_moves;
+  table->target_bytes = header.target_bytes;
+  table->offsets = (const uint32_t *) ((char *) table->map + sizeof(header));
+  table->targets = table->offsets + header.number_of_states + 1;
+
+  if (!check_table(table)) {
+    fprintf(stderr, "%s: corrupt game table\n", filename);
+    gg_game_table_free(table);
+    return 0;
+  }
+  return 1;
+}
+
+
+void
+gg_game_table_from_array(struct gg_game_table *table,
+			 const int *transformations,
+			 int number_of_states, int number_of_points)
+{
+  uint32_t *offsets;
+  void *targets;
+  int n = 0;
+  int s, k;
+
+  offsets = malloc((number_of_states + 1) * sizeof(uint32_t));
+  if (!offsets) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (s = 0; s < number_of_states; s++) {
+    offsets[s] = n;
+    for (k = 0; k < 2 * number_of_points; k++)
+      if (transformations[s * 2 * number_of_points + k] >= 0)
+	n++;
+  }
+  offsets[number_of_states] = n;
+
+  table->target_bytes = number_of_states <= 65536 ? 2 : 4;
+  targets = malloc((n ? n : 1) * table->target_bytes);
+  if (!targets) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  for (n = 0, s = 0; s < number_of_states; s++)
+    for (k = 0; k < 2 * number_of_points; k++) {
+      int next_state = transformations[s * 2 * number_of_points + k];
+      if (next_state < 0)
+	continue;
+      if (table->target_bytes == 2)
+	((uint16_t *) targets)[n++] = next_state;
+      else
+	((uint32_t *) targets)[n++] = next_state;
+    }
+
+  table->number_of_states = number_of_states;
+  table->number_of_points = number_of_points;
+  table->number_of_moves = n;
+  table->offsets = offsets;
+  table->targets = targets;
+  table->map = NULL;
+  table->map_size = 0;
+  check_table(table);
+}
+
+
+int
+gg_game_table_write(const struct gg_game_table *table, const char *filename)
+{
+  struct gg_game_table_header header;
+  FILE *f;
+  int ok;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, GG_GAME_TABLE_MAGIC, sizeof(header.magic));
+  header.number_of_states = table->number_of_states;
+  header.number_of_points = table->number_of_points;
+  header.number_of_moves = table->number_of_moves;
+  header.target_bytes = table->target_bytes;
+
+  f = fopen(filename, "wb");
+  if (!f) {
+    perror(filename);
+    return 0;
+  }
+  ok = (fwrite(&header, sizeof(header), 1, f) == 1
+	&& fwrite(table->offsets, sizeof(uint32_t),
+		  table->number_of_states + 1, f)
+	   == (size_t) table->number_of_states + 1
+	&& fwrite(table->targets, table->target_bytes,
+		  table->number_of_moves, f)
+	   == (size_t) table->number_of_moves);
+  if (fclose(f) != 0)
+    ok = 0;
+  if (!ok)
+    perror(filename);
+  return ok;
+}
+
+
+void
+gg_game_table_free(struct gg_game_table *table)
+{
+  if (table->map)
+    munmap(table->map, table->map_size);
+  else {
+    free((void *) table->offsets);
+    free((void *) table->targets);
+  }
+  table->map = NULL;
+  table->offsets = NULL;
+  table->targets = NULL;
+}
+
+
+int
+gg_parse_game_table(int argc, char **argv, int *i,
+		    struct gg_game_table *table)
+{
+  if (strcmp(argv[*i], "--table") || *i + 1 >= argc)
+    return 0;
+  if (!gg_game_table_load(table, argv[++*i]))
+    exit(1);
+  return 1;
+}
+
+
+/*
+ * Local Variables:
+ * tab-width: 8
+ * c-basic-offset: 2
+ * End:
+ */
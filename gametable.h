@@ -0,0 +1,95 @@
+/* gametable.h - Transition tables of the game tree programs.
+ *
+ * The number_of_games and estimate_number_of_games programs walk the
+ * graph of board positions where row s of the transition table lists
+ * the positions reachable from position s by one move. Compiled in,
+ * the table is an int array with 2 * NUMBER_OF_POINTS entries per row,
+ * padded with -1. Here the rows are instead stored back to back (the
+ * CSR layout): the moves from s are targets[offsets[s]] up to
+ * targets[offsets[s + 1] - 1], in the order of the compiled table.
+ * Targets take 16 bits when there are at most 65536 positions and 32
+ * bits otherwise.
+ *
+ * A table file, as written by gg_game_table_write and make_game_table,
+ * is in native byte order
+ *
+ *   struct gg_game_table_header
+ *   uint32_t offsets[number_of_states + 1]
+ *   uint16_t or uint32_t targets[number_of_moves]
+ *
+ * and is mapped read only, so one build of a program serves every
+ * board and the table costs no more memory than its moves.
+ */
+
+#ifndef _GAMETABLE_H_
+#define _GAMETABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GG_GAME_TABLE_MAGIC "GGTABLE1"
+
+struct gg_game_table_header {
+  char magic[8];
+  uint32_t number_of_states;
+  uint32_t number_of_points;
+  uint32_t number_of_moves;   /* Sum of the row lengths. */
+  uint32_t target_bytes;      /* 2 or 4. */
+};
+
+struct gg_game_table {
+  int number_of_states;
+  int number_of_points;
+  int number_of_moves;
+  int max_moves;              /* Longest row. */
+  int target_bytes;
+  const uint32_t *offsets;
+  const void *targets;
+  void *map;                  /* The mapped file, or NULL. */
+  size_t map_size;
+};
+
+/* Target i of the table, counting over all rows. */
+static inline int
+gg_game_table_target(const struct gg_game_table *table, uint32_t i)
+{
+  if (table->target_bytes == 2)
+    return ((const uint16_t *) table->targets)[i];
+  return ((const uint32_t *) table->targets)[i];
+}
+
+/* Map the table file filename. Returns 0 and prints a message if it
+ * cannot be read or is malformed.
+ */
+int gg_game_table_load(struct gg_game_table *table, const char *filename);
+
+/* Build a table from a compiled transformations array with
+ * number_of_states rows of 2 * number_of_points entries, skipping the
+ * negative ones.
+ */
+void gg_game_table_from_array(struct gg_game_table *table,
+			      const int *transformations,
+			      int number_of_states, int number_of_points);
+
+/* Write the table to filename. Returns 0 on failure. */
+int gg_game_table_write(const struct gg_game_table *table,
+			const char *filename);
+
+void gg_game_table_free(struct gg_game_table *table);
+
+/* Parse a --table option at argv[*i], advancing *i past its value.
+ * Return 1 and load the table if it is there, else return 0. Exits if
+ * the table cannot be loaded.
+ */
+int gg_parse_game_table(int argc, char **argv, int *i,
+			struct gg_game_table *table);
+
+#endif /* _GAMETABLE_H_ */
+
+
+/*
+ * Local Variables:
+ * tab-width: 8
+ * c-basic-offset: 2
+ * End:
+ */
@@ -0,0 +1,701 @@
+/* legal5.c - Count the number of legal go boards of odd size with a
+ * rotating border.
+ *
+ * This is a C version of legal5.pike, see that file for a description
+ * of the algorithm and of the state alphabet. A state is a 64-bit word
+ * with 4 bits per symbol, as the border states of
+ * tromp_programs/states.c use 3 bits per cell: N symbols for the
+ * border followed by M symbols for the fates of the liberty-less
+ * strings on the initial ray. All state manipulation works on the
+ * packed word, with the symbol classes of legal5.pike as bit masks
+ * over the codes. Border state counts are accumulated in open
+ * addressing hash tables, modulo one of the same moduli as used by
+ * tromp_programs/memlegal.c, so that results can be compared and
+ * combined with the Chinese remainder theorem.
+ *
+ * The analysis is repeated for each of the 3^N colorings of the
+ * initial ray, as the final check depends on it, so no states can be
+ * shared between rays. Swapping the colors of a whole board maps the
+ * boards of a ray one to one to those of the swapped ray, so only one
+ * ray of each swapped pair is analyzed and counted twice.
+ *
+ * One deviation from legal5.pike: when an initial string leaves the
+ * border without a liberty, legal5.pike marks all its fate entries
+ * with "|", which loses the information that two initial strings had
+ * merged before that. The final check then wrongly rejects boards
+ * where only one of them gets a liberty on the revisited ray, e.g.
+ * 2 of the 81 ray configurations on 7x7. Here the fate entries of such
+ * a string are instead all set to "A"+j, where j is the first of the
+ * entries, and the final check resolves them together.
+ *
+ * With N up to 7 the packed state fits in 64 bits, i.e. boards up to
+ * 13x13.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+
+#define MAXN 7
+
+typedef unsigned long Word_t;
+
+Word_t moduli[] = {
+0L, // 2^64
+-3L, // 13 3889 364870227143809
+-5L, // 11 59 98818999 287630261
+-7L, // 3^2 818923289 2502845209
+-9L, // 7 9241 464773 613566757
+-11L, // 5 2551 1446236305269271
+-15L, // 53 348051774975651917
+-17L, // 19 67 14490765179661863
+-33L, // 827 3894899 5726879071
+-35L, // 17 72786899 14907938207
+-39L // 139646831 132095686967
+};
+
+#define NMODULI (int)(((sizeof moduli)/(sizeof(Word_t))))
+
+Word_t modulus = 0L;
+
+void mod_add(Word_t *a, Word_t b)
+{
+  Word_t c = *a + b;
+  if (c < b || c >= modulus)
+    c -= modulus;
+  *a = c;
+}
+
+/* Symbol k of a state, and setting it. */
+#define GET(s,k) ((int) ((s) >> (4 * (k))) & 15)
+#define NSET(s,k,d) s = ((s) & ~(15L << (4 * (k)))) | ((Word_t) (d) << (4 * (k)))
+
+/* Border symbol codes, the positions in "|.XOSUDBsudb". A liberty-less
+ * string of color c (0 black, 1 white) uses the codes SYM(c,t) for the
+ * types single, up, down and both.
+ */
+#define EDGE 0
+#define EMPTY 1
+#define STONE(c) (2 + (c))
+#define SINGLE 0
+#define UP 1
+#define DOWN 2
+#define BOTH 3
+#define SYM(c,t) (4 + 4 * (c) + (t))
+#define IS(mask,d) (((mask) >> (d)) & 1)
+#define FREE ((1 << EMPTY) | (1 << STONE(0)) | (1 << STONE(1))) /* "OX." */
+#define ORIGIN ((1 << SYM(0, SINGLE)) | (1 << SYM(0, UP))		\
+		| (1 << SYM(1, SINGLE)) | (1 << SYM(1, UP)))     /* "sSuU" */
+#define SYMBOLS "|.XOSUDBsudb"
+
+/* Fate codes are 0 for '.', 1 + k for 'a' + k, a string on border
+ * position k, and GONE + j for 'A' + j.
+ */
+#define GONE (MAXN + 1)
+
+int N;       /* Length of the ray, the board is (2N-1)x(2N-1). */
+int M;       /* Number of liberty-less strings on the initial ray. */
+Word_t initial_state;
+
+/* Color of a liberty-less string symbol, -1 if it is something else. */
+static inline int
+string_color(int d)
+{
+  return d >= SYM(0, SINGLE) ? (d - SYM(0, SINGLE)) >> 2 : -1;
+}
+
+
+/* Open addressing hash table from packed states to counts. */
+
+#define EMPTYKEY (~(Word_t) 0)
+
+struct table {
+  Word_t *keys;
+  Word_t *counts;
+  Word_t size;
+  Word_t n;
+};
+
+static Word_t
+hash(Word_t key, Word_t size)
+{
+  return ((key * 0x9e3779b97f4a7c15UL) >> 17) & (size - 1);
+}
+
+static void
+table_init(struct table *t, Word_t size)
+{
+  Word_t k;
+  t->size = size;
+  t->n = 0;
+  t->keys = malloc(size * sizeof(Word_t));
+  t->counts = malloc(size * sizeof(Word_t));
+  assert(t->keys && t->counts);
+  for (k = 0; k < size; k++)
+    t->keys[k] = EMPTYKEY;
+}
+
+static void
+table_free(struct table *t)
+{
+  free(t->keys);
+  free(t->counts);
+}
+
+static void table_add(struct table *t, Word_t key, Word_t count);
+
+static void
+table_grow(struct table *t)
+{
+  struct table old = *t;
+  Word_t k;
+  table_init(t, 2 * old.size);
+  for (k = 0; k < old.size; k++)
+    if (old.keys[k] != EMPTYKEY)
+      table_add(t, old.keys[k], old.counts[k]);
+  table_free(&old);
+}
+
+static void
+table_add(struct table *t, Word_t key, Word_t count)
+{
+  Word_t h = hash(key, t->size);
+  while (t->keys[h] != EMPTYKEY && t->keys[h] != key)
+    h = (h + 1) & (t->size - 1);
+  if (t->keys[h] == key) {
+    mod_add(&t->counts[h], count);
+    return;
+  }
+  t->keys[h] = key;
+  t->counts[h] = count;
+  if (2 * ++t->n > t->size)
+    table_grow(t);
+}
+
+
+/* The state manipulation below follows legal5.pike closely. */
+
+static void
+change_state(Word_t *s, int k, int d)
+{
+  int j;
+  if (IS(ORIGIN, GET(*s, k)) && IS(FREE, d))
+    for (j = N; j < N + M; j++)
+      if (GET(*s, j) == 1 + k)
+	NSET(*s, j, 0);
+  NSET(*s, k, d);
+}
+
+/* With to < 0 the string has left the border without liberties. */
+static void
+move_origin(Word_t *s, int from, int to)
+{
+  int to_fate = to >= 0 ? 1 + to : 0;
+  int j;
+  for (j = N; j < N + M; j++)
+    if (GET(*s, j) == 1 + from) {
+      if (!to_fate)
+	to_fate = GONE + j - N;
+      NSET(*s, j, to_fate);
+    }
+}
+
+static void
+string_obtained_liberty(Word_t *s, int i, int color)
+{
+  int d = GET(*s, i);
+  int nesting = 0;
+  int k;
+
+  if (d == SYM(color, UP) || d == SYM(color, BOTH))
+    for (k = i + 1; k < N; k++) {
+      int e = GET(*s, k);
+      if (e == SYM(color, UP))
+	nesting++;
+      else if (e == SYM(color, DOWN)) {
+	if (nesting == 0) {
+	  change_state(s, k, STONE(color));
+	  break;
+	}
+	else
+	  nesting--;
+      }
+      else if (e == SYM(color, BOTH) && nesting == 0)
+	change_state(s, k, STONE(color));
+    }
+
+  if (d == SYM(color, DOWN) || d == SYM(color, BOTH))
+    for (k = i - 1; k >= 0; k--) {
+      int e = GET(*s, k);
+      if (e == SYM(color, DOWN))
+	nesting++;
+      else if (e == SYM(color, UP)) {
+	if (nesting == 0) {
+	  change_state(s, k, STONE(color));
+	  break;
+	}
+	else
+	  nesting--;
+      }
+      else if (e == SYM(color, BOTH) && nesting == 0)
+	change_state(s, k, STONE(color));
+    }
+
+  change_state(s, i, STONE(color));
+}
+
+static void
+remove_from_string(Word_t *s, int i, int color)
+{
+  int d = GET(*s, i);
+  int nesting = 0;
+  int k;
+
+  if (d == SYM(color, UP))
+    for (k = i + 1; k < N; k++) {
+      int e = GET(*s, k);
+      if (e == SYM(color, UP))
+	nesting++;
+      else if (e == SYM(color, DOWN)) {
+	if (nesting == 0) {
+	  NSET(*s, k, SYM(color, SINGLE));
+	  move_origin(s, i, k);
+	  return;
+	}
+	else
+	  nesting--;
+      }
+      else if (e == SYM(color, BOTH) && nesting == 0) {
+	NSET(*s, k, SYM(color, UP));
+	move_origin(s, i, k);
+	return;
+      }
+    }
+
+  if (d == SYM(color, DOWN))
+    for (k = i - 1; k >= 0; k--) {
+      int e = GET(*s, k);
+      if (e == SYM(color, DOWN))
+	nesting++;
+      else if (e == SYM(color, UP)) {
+	if (nesting == 0) {
+	  NSET(*s, k, SYM(color, SINGLE));
+	  return;
+	}
+	else
+	  nesting--;
+      }
+      else if (e == SYM(color, BOTH) && nesting == 0) {
+	NSET(*s, k, SYM(color, DOWN));
+	return;
+      }
+    }
+
+  if (d == SYM(color, SINGLE))
+    move_origin(s, i, -1);
+}
+
+static void
+impossible(const char *where, Word_t s, int i)
+{
+  int k;
+  fprintf(stderr, "Impossible situation - %s: ", where);
+  for (k = 0; k < N; k++)
+    fputc(SYMBOLS[GET(s, k)], stderr);
+  fprintf(stderr, " %d\n", i);
+  exit(1);
+}
+
+static int
+find_lower_end(Word_t s, int i, int color)
+{
+  int d = GET(s, i);
+  int nesting = 0;
+  int k;
+
+  if (d == SYM(color, SINGLE) || d == SYM(color, UP))
+    return i;
+
+  for (k = i - 1; k >= 0; k--) {
+    int e = GET(s, k);
+    if (e == SYM(color, DOWN))
+      nesting++;
+    else if (e == SYM(color, UP)) {
+      if (nesting == 0)
+	return k;
+      else
+	nesting--;
+    }
+  }
+
+  impossible("B", s, i);
+  return -1;
+}
+
+static int
+find_upper_end(Word_t s, int i, int color)
+{
+  int nesting = 0;
+  int k;
+
+  for (k = i + 1; k < N; k++) {
+    int e = GET(s, k);
+    if (e == SYM(color, UP))
+      nesting++;
+    else if (e == SYM(color, DOWN)) {
+      if (nesting == 0)
+	return k;
+      else
+	nesting--;
+    }
+  }
+
+  impossible("C", s, i);
+  return -1;
+}
+
+/* Add a stone of the given color at position i. Return 0 if the
+ * configuration is illegal.
+ */
+static int
+add_stone(Word_t *s, int i, int left, int down, int color)
+{
+  int own_left = string_color(left) == color;
+  int own_down = string_color(down) == color;
+  int j, k;
+
+  /* A liberty-less opponent string to the left losing its last
+   * border stone is dead, unless it is one of the initial strings.
+   */
+  if (left == SYM(1 - color, SINGLE)) {
+    for (k = N; k < N + M; k++)
+      if (GET(*s, k) == 1 + i)
+	break;
+    if (k == N + M)
+      return 0;
+  }
+
+  if (string_color(left) == 1 - color)
+    remove_from_string(s, i, 1 - color);
+
+  if (left == STONE(color) || left == EMPTY
+      || down == STONE(color) || down == EMPTY) {
+    if (own_left)
+      string_obtained_liberty(s, i, color);
+    else if (own_down)
+      string_obtained_liberty(s, i - 1, color);
+    NSET(*s, i, STONE(color));
+  }
+  else if (own_left && own_down) {
+    /* Merge two liberty-less strings. */
+    if (down == SYM(color, SINGLE)) {
+      if (left == SYM(color, SINGLE)) {
+	NSET(*s, i - 1, SYM(color, UP));
+	NSET(*s, i, SYM(color, DOWN));
+	move_origin(s, i, i - 1);
+      }
+      else if (left == SYM(color, UP)) {
+	NSET(*s, i - 1, SYM(color, UP));
+	NSET(*s, i, SYM(color, BOTH));
+	move_origin(s, i, i - 1);
+      }
+      else
+	NSET(*s, i - 1, SYM(color, BOTH));
+    }
+    else if (down == SYM(color, DOWN)) {
+      j = find_lower_end(*s, i - 1, color);
+      if (left == SYM(color, SINGLE)) {
+	NSET(*s, i - 1, SYM(color, BOTH));
+	NSET(*s, i, SYM(color, DOWN));
+	move_origin(s, i, j);
+      }
+      else if (left == SYM(color, UP)) {
+	NSET(*s, i - 1, SYM(color, BOTH));
+	NSET(*s, i, SYM(color, BOTH));
+	move_origin(s, i, j);
+      }
+      else {
+	NSET(*s, i - 1, SYM(color, BOTH));
+	NSET(*s, j, SYM(color, BOTH));
+      }
+    }
+    else {
+      if (left == SYM(color, SINGLE)) {
+	j = find_lower_end(*s, i - 1, color);
+	NSET(*s, i, SYM(color, BOTH));
+	move_origin(s, i, j);
+      }
+      else if (left == SYM(color, UP)) {
+	j = find_upper_end(*s, i, color);
+	k = find_lower_end(*s, i - 1, color);
+	NSET(*s, i, SYM(color, BOTH));
+	NSET(*s, j, SYM(color, BOTH));
+	move_origin(s, i, k);
+      }
+    }
+  }
+  else if (own_down) {
+    /* Extend the liberty-less string below. */
+    if (down == SYM(color, SINGLE) || down == SYM(color, DOWN)) {
+      NSET(*s, i, SYM(color, DOWN));
+      NSET(*s, i - 1, down == SYM(color, SINGLE)
+	   ? SYM(color, UP) : SYM(color, BOTH));
+    }
+    else
+      NSET(*s, i, SYM(color, BOTH));
+  }
+  else if (!own_left)
+    NSET(*s, i, SYM(color, SINGLE));
+
+  return 1;
+}
+
+/* Add one vertex at position i to all states in old, with stone
+ * values 0 (empty), 1 (black), 2 (white), or only allowed_value if
+ * that is non-negative.
+ */
+static void
+add_one_vertex(struct table *old, struct table *new, int i,
+	       int single_neighbor, int allowed_value)
+{
+  Word_t s;
+  int left, down;
+  Word_t h;
+  int v;
+  int color;
+
+  table_init(new, old->size);
+  for (h = 0; h < old->size; h++) {
+    if (old->keys[h] == EMPTYKEY)
+      continue;
+    left = GET(old->keys[h], i);
+    down = single_neighbor ? EDGE : GET(old->keys[h], i - 1);
+    for (v = 0; v < 3; v++) {
+      if (allowed_value >= 0 && v != allowed_value)
+	continue;
+      s = old->keys[h];
+      if (v == 0) {
+	/* An empty vertex gives liberties to strings left and below. */
+	for (color = 0; color < 2; color++) {
+	  if (string_color(left) == color)
+	    string_obtained_liberty(&s, i, color);
+	  if (string_color(down) == color)
+	    string_obtained_liberty(&s, i - 1, color);
+	}
+	NSET(s, i, EMPTY);
+      }
+      else if (!add_stone(&s, i, left, down, v - 1))
+	continue;
+      table_add(new, s, old->counts[h]);
+    }
+  }
+  table_free(old);
+}
+
+static int
+legal_starting_and_finishing_states(Word_t s)
+{
+  int found_one = 1;
+  int color;
+  int i, j, k;
+
+  while (found_one) {
+    found_one = 0;
+    for (k = 0; k < N; k++) {
+      int fate;
+      if (!IS(FREE, GET(s, k)))
+	continue;
+      for (j = 0; j < M; j++)
+	if (GET(initial_state, N + j) == 1 + k)
+	  break;
+      if (j == M || (fate = GET(s, N + j)) == 0)
+	continue;
+      found_one = 1;
+      if (fate >= GONE) {
+	for (i = N; i < N + M; i++)
+	  if (GET(s, i) == fate)
+	    NSET(s, i, 0);
+      }
+      else {
+	i = fate - 1;
+	if ((color = string_color(GET(s, i))) >= 0)
+	  string_obtained_liberty(&s, i, color);
+	else
+	  NSET(s, N + j, 0);
+      }
+    }
+    for (k = N; k < N + M; k++) {
+      if (GET(s, k) != 0)
+	continue;
+      j = GET(initial_state, k) - 1;
+      if ((color = string_color(GET(s, j))) < 0)
+	continue;
+      string_obtained_liberty(&s, j, color);
+      found_one = 1;
+    }
+  }
+
+  for (k = 0; k < N; k++)
+    if (!IS(FREE, GET(s, k)))
+      return 0;
+  for (k = N; k < N + M; k++)
+    if (GET(s, k) != 0)
+      return 0;
+  return 1;
+}
+
+Word_t max_border_states = 0;
+
+/* Number of boards with the ray initial_state, times count. */
+static Word_t
+rotating_border_analysis(Word_t count)
+{
+  struct table t;
+  Word_t sum = 0;
+  Word_t h;
+  int i, j, k;
+
+  table_init(&t, 16);
+  table_add(&t, initial_state, count);
+  for (k = 0; k < 4; k++) {
+    for (j = 1; j < N; j++)
+      for (i = j; i < N; i++) {
+	struct table new;
+	add_one_vertex(&t, &new, i, i == j, -1);
+	t = new;
+	if (t.n > max_border_states)
+	  max_border_states = t.n;
+      }
+
+    for (j = N - 1; j >= 1; j--)
+      for (i = j; i < N; i++) {
+	struct table new;
+	int allowed_value = -1;
+	if (k == 3 && j == 1) {
+	  int d = GET(initial_state, i);
+	  if (d == STONE(1) || string_color(d) == 1)
+	    allowed_value = 2;
+	  else if (d == STONE(0) || string_color(d) == 0)
+	    allowed_value = 1;
+	  else
+	    allowed_value = 0;
+	}
+	add_one_vertex(&t, &new, i, 0, allowed_value);
+	t = new;
+	if (t.n > max_border_states)
+	  max_border_states = t.n;
+      }
+  }
+
+  for (h = 0; h < t.size; h++)
+    if (t.keys[h] != EMPTYKEY
+	&& legal_starting_and_finishing_states(t.keys[h]))
+      mod_add(&sum, t.counts[h]);
+  table_free(&t);
+  return sum;
+}
+
+/* The ray s with black and white swapped. */
+static Word_t
+swap_colors(Word_t s)
+{
+  int k;
+  for (k = 0; k < N; k++) {
+    int d = GET(s, k);
+    if (d == STONE(0) || d == STONE(1))
+      NSET(s, k, STONE(1) + STONE(0) - d);
+    else if (string_color(d) >= 0)
+      NSET(s, k, d ^ 12);
+  }
+  return s;
+}
+
+static Word_t
+count_legal_boards(int side)
+{
+  struct table initial_states;
+  Word_t sum = 0;
+  Word_t h;
+  int i, k;
+  int analyzed = 0;
+
+  N = (side + 1) / 2;
+  M = 0;
+
+  /* Traverse the initial ray, starting from all EDGE. */
+  table_init(&initial_states, 16);
+  table_add(&initial_states, 0L, 1);
+  for (i = 0; i < N; i++) {
+    struct table new;
+    add_one_vertex(&initial_states, &new, i, i == 0, -1);
+    initial_states = new;
+  }
+  printf("%lu initial ray states\n", initial_states.n);
+
+  /* Loop over the initial ray configurations, one of each pair of
+   * color swapped ones.
+   */
+  for (h = 0; h < initial_states.size; h++) {
+    Word_t ray = initial_states.keys[h];
+    Word_t swapped = swap_colors(ray);
+    Word_t count;
+    if (ray == EMPTYKEY || swapped < ray)
+      continue;
+    M = 0;
+    initial_state = ray;
+    for (k = 0; k < N; k++)
+      if (IS(ORIGIN, GET(ray, k))) {
+	NSET(initial_state, N + M, 1 + k);
+	M++;
+      }
+    count = rotating_border_analysis(initial_states.counts[h]);
+    mod_add(&sum, count);
+    if (swapped != ray)
+      mod_add(&sum, count);
+    analyzed++;
+  }
+  printf("%d rays analyzed\n", analyzed);
+  table_free(&initial_states);
+  return sum;
+}
+
+int
+main(int argc, char **argv)
+{
+  int side;
+  int modidx = 0;
+  Word_t num_legal;
+  clock_t start = clock();
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: legal5 side [modulo_index]\n");
+    return 1;
+  }
+
+  side = atoi(argv[1]);
+  if (side < 1 || !(side % 2) || (side + 1) / 2 > MAXN) {
+    fprintf(stderr, "The size must be odd and at most %d.\n", 2 * MAXN - 1);
+    return 1;
+  }
+  if (argc > 2)
+    modidx = atoi(argv[2]);
+  if (modidx < 0 || modidx >= NMODULI) {
+    fprintf(stderr, "modulo_index %d not in range [0,%d)\n", modidx, NMODULI);
+    return 1;
+  }
+  modulus = moduli[modidx];
+
+  num_legal = count_legal_boards(side);
+
+  printf("Max number of border states: %lu\n", max_border_states);
+  printf("Time: %.2f s\n", (double) (clock() - start) / CLOCKS_PER_SEC);
+  printf("legal(%dx%d) %% ", side, side);
+  if (modulus)
+    printf("%lu", modulus);
+  else
+    printf("18446744073709551616");
+  printf(" = %lu\n", num_legal);
+
+  return 0;
+}
@@ -0,0 +1,548 @@
+/* legal_graph.c - Count the number of legal go positions on an arbitrary
+ * board graph.
+ *
+ * The vertices are added one at a time in an elimination order and the
+ * positions are counted by dynamic programming over the frontier, the
+ * added vertices which still have neighbors to be added. As in
+ * tromp_programs/states.c, stones on the frontier are either known to
+ * belong to a string with a liberty, which is all we need to know about
+ * them, or belong to a needy string without liberty so far, in which
+ * case the frontier state also records which needy stones are in the
+ * same string. A needy string must get a liberty before its last stone
+ * leaves the frontier.
+ *
+ * The elimination order is found greedily, adding the vertex which
+ * gives the smallest frontier, starting from each vertex in turn and
+ * keeping the order with the smallest maximum frontier. The time is
+ * exponential in this frontier size rather than in the number of
+ * vertices. For rectangles it is the shorter side, for a torus about
+ * twice the shorter circumference.
+ *
+ * The board is given as
+ *   legal_graph rect W H      W x H rectangle,
+ *   legal_graph cylinder W H  W x H with the W sides wrapping around,
+ *   legal_graph torus W H     W x H with both sides wrapping around,
+ *   legal_graph file name     read from a file, "-" for stdin,
+ * optionally followed by a modulo index as for legal5.
+ *
+ * A board file has one line per vertex, the vertex number followed by
+ * its neighbors. Any non-digit characters separate the numbers, so the
+ * lines of the connections mappings in number_of_games.pike, like
+ * "1:({0,2,4}),", can be used directly. Edges need only be listed in
+ * one direction.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <time.h>
+
+#define MAXVERTICES 1024
+#define MAXNEIGHBORS 16
+#define MAXFRONTIER 64
+
+typedef unsigned long Word_t;
+
+Word_t moduli[] = {
+0L, // 2^64
+-3L, // 13 3889 364870227143809
+-5L, // 11 59 98818999 287630261
+-7L, // 3^2 818923289 2502845209
+-9L, // 7 9241 464773 613566757
+-11L, // 5 2551 1446236305269271
+-15L, // 53 348051774975651917
+-17L, // 19 67 14490765179661863
+-33L, // 827 3894899 5726879071
+-35L, // 17 72786899 14907938207
+-39L // 139646831 132095686967
+};
+
+#define NMODULI (int)(((sizeof moduli)/(sizeof(Word_t))))
+
+Word_t modulus = 0L;
+
+void mod_add(Word_t *a, Word_t b)
+{
+  Word_t c = *a + b;
+  if (c < b || c >= modulus)
+    c -= modulus;
+  *a = c;
+}
+
+int num_vertices;
+int num_neighbors[MAXVERTICES];
+int neighbors[MAXVERTICES][MAXNEIGHBORS];
+
+static void
+add_edge(int a, int b)
+{
+  int k;
+  if (a == b)
+    return;
+  if (a < 0 || b < 0 || a >= MAXVERTICES || b >= MAXVERTICES) {
+    fprintf(stderr, "Vertex numbers must be in [0,%d).\n", MAXVERTICES);
+    exit(1);
+  }
+  for (k = 0; k < num_neighbors[a]; k++)
+    if (neighbors[a][k] == b)
+      return;
+  if (num_neighbors[a] == MAXNEIGHBORS || num_neighbors[b] == MAXNEIGHBORS) {
+    fprintf(stderr, "At most %d neighbors per vertex.\n", MAXNEIGHBORS);
+    exit(1);
+  }
+  neighbors[a][num_neighbors[a]++] = b;
+  neighbors[b][num_neighbors[b]++] = a;
+  if (a >= num_vertices)
+    num_vertices = a + 1;
+  if (b >= num_vertices)
+    num_vertices = b + 1;
+}
+
+/* Grid boards, wrapping around horizontally and/or vertically. */
+static void
+make_grid(int width, int height, int wrapx, int wrapy)
+{
+  int x, y;
+  if (width * height > MAXVERTICES) {
+    fprintf(stderr, "At most %d vertices.\n", MAXVERTICES);
+    exit(1);
+  }
+  num_vertices = width * height;
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++) {
+      if (x + 1 < width || (wrapx && width > 2))
+	add_edge(y * width + x, y * width + (x + 1) % width);
+      if (y + 1 < height || (wrapy && height > 2))
+	add_edge(y * width + x, ((y + 1) % height) * width + x);
+    }
+}
+
+static void
+read_graph(FILE *f)
+{
+  char line[4096];
+  while (fgets(line, sizeof(line), f)) {
+    char *s = line;
+    int v = -1;
+    while (*s) {
+      if (isdigit((unsigned char) *s)) {
+	int n = strtol(s, &s, 10);
+	if (v < 0) {
+	  v = n;
+	  if (v >= MAXVERTICES) {
+	    fprintf(stderr, "Vertex numbers must be in [0,%d).\n",
+		    MAXVERTICES);
+	    exit(1);
+	  }
+	  if (v >= num_vertices)
+	    num_vertices = v + 1;
+	}
+	else
+	  add_edge(v, n);
+      }
+      else
+	s++;
+    }
+  }
+}
+
+
+/* Elimination order. */
+
+int order[MAXVERTICES];
+int position[MAXVERTICES];
+
+/* Greedy order from the given start vertex, returns the maximum
+ * frontier size.
+ */
+static int
+greedy_order(int start, int *ord)
+{
+  int remaining[MAXVERTICES];
+  int added[MAXVERTICES];
+  int frontier = 0;
+  int max_frontier = 0;
+  int i, k, u, v;
+
+  for (v = 0; v < num_vertices; v++) {
+    remaining[v] = num_neighbors[v];
+    added[v] = 0;
+  }
+  for (i = 0; i < num_vertices; i++) {
+    int best = -1;
+    int best_delta = 0;
+    int best_links = 0;
+    for (u = 0; u < num_vertices; u++) {
+      int delta, links = 0;
+      if (added[u])
+	continue;
+      if (i == 0 && u != start)
+	continue;
+      delta = remaining[u] > 0;
+      for (k = 0; k < num_neighbors[u]; k++) {
+	v = neighbors[u][k];
+	if (added[v]) {
+	  links++;
+	  if (remaining[v] == 1)
+	    delta--;
+	}
+      }
+      /* Prefer vertices next to the added ones, to keep the frontier
+       * connected.
+       */
+      if (i > 0 && links == 0 && frontier > 0)
+	delta += MAXVERTICES;
+      if (best < 0 || delta < best_delta
+	  || (delta == best_delta && links > best_links)) {
+	best = u;
+	best_delta = delta;
+	best_links = links;
+      }
+    }
+    ord[i] = best;
+    added[best] = 1;
+    for (k = 0; k < num_neighbors[best]; k++)
+      remaining[neighbors[best][k]]--;
+    frontier = 0;
+    for (v = 0; v < num_vertices; v++)
+      if (added[v] && remaining[v] > 0)
+	frontier++;
+    if (frontier > max_frontier)
+      max_frontier = frontier;
+  }
+  return max_frontier;
+}
+
+static int
+find_order(void)
+{
+  int ord[MAXVERTICES];
+  int best = -1;
+  int start, f, i;
+
+  for (start = 0; start < num_vertices; start++) {
+    f = greedy_order(start, ord);
+    if (best < 0 || f < best) {
+      best = f;
+      memcpy(order, ord, num_vertices * sizeof(int));
+    }
+  }
+  for (i = 0; i < num_vertices; i++)
+    position[order[i]] = i;
+  return best;
+}
+
+
+/* Frontier states are byte strings with one code per frontier vertex:
+ * EMPTY, a stone of a string with a liberty, or NEEDY + 2 * label +
+ * color for a stone of a needy string. Labels are numbered in order of
+ * first occurrence.
+ */
+
+#define EMPTY 0
+#define LIBSTONE 1 /* + color */
+#define NEEDY 3
+
+/* Open addressing hash table from frontier states to counts. Each key
+ * is preceded by a byte which is nonzero for used entries.
+ */
+
+struct table {
+  unsigned char *keys;
+  Word_t *counts;
+  Word_t size;
+  Word_t n;
+  int keylen;
+};
+
+static Word_t
+hash(const unsigned char *key, int keylen, Word_t size)
+{
+  Word_t h = 14695981039346656037UL;
+  int k;
+  for (k = 0; k < keylen; k++)
+    h = (h ^ key[k]) * 1099511628211UL;
+  return (h ^ (h >> 29)) & (size - 1);
+}
+
+static void
+table_init(struct table *t, Word_t size, int keylen)
+{
+  t->size = size;
+  t->n = 0;
+  t->keylen = keylen;
+  t->keys = calloc(size, keylen + 1);
+  t->counts = malloc(size * sizeof(Word_t));
+  assert(t->keys && t->counts);
+}
+
+static void
+table_free(struct table *t)
+{
+  free(t->keys);
+  free(t->counts);
+}
+
+static void table_add(struct table *t, const unsigned char *key, Word_t count);
+
+static void
+table_grow(struct table *t)
+{
+  struct table old = *t;
+  Word_t h;
+  table_init(t, 2 * old.size, old.keylen);
+  for (h = 0; h < old.size; h++)
+    if (old.keys[h * (old.keylen + 1)])
+      table_add(t, old.keys + h * (old.keylen + 1) + 1, old.counts[h]);
+  table_free(&old);
+}
+
+static void
+table_add(struct table *t, const unsigned char *key, Word_t count)
+{
+  int stride = t->keylen + 1;
+  Word_t h = hash(key, t->keylen, t->size);
+  unsigned char *p;
+
+  while (1) {
+    p = t->keys + h * stride;
+    if (!p[0])
+      break;
+    if (!memcmp(p + 1, key, t->keylen)) {
+      mod_add(&t->counts[h], count);
+      return;
+    }
+    h = (h + 1) & (t->size - 1);
+  }
+  p[0] = 1;
+  memcpy(p + 1, key, t->keylen);
+  t->counts[h] = count;
+  if (2 * ++t->n > t->size)
+    table_grow(t);
+}
+
+
+/* Add vertex order[i] with the given contents (-1 empty, 0 black,
+ * 1 white) to a state over the frontier before, and store the resulting
+ * state over the frontier after in new_state. Returns 0 if a needy
+ * string leaves the frontier.
+ */
+static int
+add_vertex(int i, int content, const unsigned char *state,
+	   int *before, int num_before, int *after, int num_after,
+	   unsigned char *new_state)
+{
+  int color[MAXFRONTIER + 1];
+  int label[MAXFRONTIER + 1]; /* -1 for strings with a liberty */
+  int relabel[MAXFRONTIER + 1];
+  int v = order[i];
+  int n = num_before;
+  int k, j, a, new_label, num_labels;
+  int has_liberty;
+
+  for (k = 0; k < n; k++) {
+    int c = state[k];
+    if (c == EMPTY)
+      color[k] = -1, label[k] = -1;
+    else if (c < NEEDY)
+      color[k] = c - LIBSTONE, label[k] = -1;
+    else
+      color[k] = (c - NEEDY) & 1, label[k] = (c - NEEDY) >> 1;
+  }
+  new_label = MAXFRONTIER;
+
+  /* Slot n is the new vertex. */
+  color[n] = content;
+  label[n] = -1;
+  if (content < 0) {
+    for (k = 0; k < n; k++)
+      if (label[k] >= 0) {
+	for (a = 0; a < num_neighbors[v]; a++)
+	  if (neighbors[v][a] == before[k])
+	    break;
+	if (a < num_neighbors[v]) {
+	  int l = label[k];
+	  for (j = 0; j < n; j++)
+	    if (label[j] == l)
+	      label[j] = -1;
+	}
+      }
+  }
+  else {
+    int merged[MAXFRONTIER];
+    int num_merged = 0;
+    has_liberty = 0;
+    for (k = 0; k < n; k++) {
+      for (a = 0; a < num_neighbors[v]; a++)
+	if (neighbors[v][a] == before[k])
+	  break;
+      if (a == num_neighbors[v])
+	continue;
+      if (color[k] < 0)
+	has_liberty = 1;
+      else if (color[k] == content) {
+	if (label[k] < 0)
+	  has_liberty = 1;
+	else
+	  merged[num_merged++] = label[k];
+      }
+    }
+    for (k = 0; k < n; k++)
+      for (j = 0; j < num_merged; j++)
+	if (label[k] == merged[j] && color[k] == content) {
+	  label[k] = has_liberty ? -1 : new_label;
+	  break;
+	}
+    label[n] = has_liberty ? -1 : new_label;
+  }
+
+  /* Check that needy strings leaving the frontier have stones left on
+   * it, and renumber the labels.
+   */
+  for (k = 0; k <= MAXFRONTIER; k++)
+    relabel[k] = -1;
+  num_labels = 0;
+  for (j = 0; j < num_after; j++) {
+    if (after[j] == v)
+      k = n;
+    else
+      for (k = 0; before[k] != after[j]; k++)
+	;
+    if (color[k] < 0)
+      new_state[j] = EMPTY;
+    else if (label[k] < 0)
+      new_state[j] = LIBSTONE + color[k];
+    else {
+      if (relabel[label[k]] < 0)
+	relabel[label[k]] = num_labels++;
+      new_state[j] = NEEDY + 2 * relabel[label[k]] + color[k];
+    }
+  }
+  for (k = 0; k <= n; k++)
+    if (label[k] >= 0 && relabel[label[k]] < 0)
+      return 0;
+  return 1;
+}
+
+/* Frontier after adding the first i+1 vertices of the order. */
+static int
+frontier(int i, int *f)
+{
+  int n = 0;
+  int j, k;
+  for (j = 0; j <= i; j++) {
+    int v = order[j];
+    for (k = 0; k < num_neighbors[v]; k++)
+      if (position[neighbors[v][k]] > i)
+	break;
+    if (k < num_neighbors[v])
+      f[n++] = v;
+  }
+  return n;
+}
+
+Word_t max_states = 0;
+
+static Word_t
+count_legal(void)
+{
+  struct table old, new;
+  int before[MAXFRONTIER], after[MAXFRONTIER];
+  int num_before = 0, num_after;
+  unsigned char new_state[MAXFRONTIER] = {0};
+  Word_t h, result;
+  int i, content;
+
+  table_init(&old, 16, 0);
+  table_add(&old, new_state, 1);
+  for (i = 0; i < num_vertices; i++) {
+    num_after = frontier(i, after);
+    table_init(&new, 16, num_after);
+    for (h = 0; h < old.size; h++) {
+      unsigned char *state = old.keys + h * (old.keylen + 1);
+      if (!state[0])
+	continue;
+      for (content = -1; content <= 1; content++)
+	if (add_vertex(i, content, state + 1, before, num_before,
+		       after, num_after, new_state))
+	  table_add(&new, new_state, old.counts[h]);
+    }
+    table_free(&old);
+    old = new;
+    if (old.n > max_states)
+      max_states = old.n;
+    memcpy(before, after, num_after * sizeof(int));
+    num_before = num_after;
+  }
+  result = 0;
+  for (h = 0; h < old.size; h++)
+    if (old.keys[h * (old.keylen + 1)])
+      mod_add(&result, old.counts[h]);
+  table_free(&old);
+  return result;
+}
+
+int
+main(int argc, char **argv)
+{
+  int modidx = 0;
+  int max_frontier;
+  int arg;
+  Word_t num_legal;
+  clock_t start = clock();
+
+  if (argc < 3) {
+    fprintf(stderr, "Usage: legal_graph rect|cylinder|torus W H [modulo_index]\n"
+	    "       legal_graph file name [modulo_index]\n");
+    return 1;
+  }
+  if (!strcmp(argv[1], "file")) {
+    FILE *f = strcmp(argv[2], "-") ? fopen(argv[2], "r") : stdin;
+    if (!f) {
+      fprintf(stderr, "Cannot open %s.\n", argv[2]);
+      return 1;
+    }
+    read_graph(f);
+    arg = 3;
+  }
+  else if (argc >= 4 && (!strcmp(argv[1], "rect")
+			 || !strcmp(argv[1], "cylinder")
+			 || !strcmp(argv[1], "torus"))) {
+    make_grid(atoi(argv[2]), atoi(argv[3]), strcmp(argv[1], "rect") != 0,
+	      !strcmp(argv[1], "torus"));
+    arg = 4;
+  }
+  else {
+    fprintf(stderr, "Unknown board %s.\n", argv[1]);
+    return 1;
+  }
+  if (argc > arg)
+    modidx = atoi(argv[arg]);
+  if (modidx < 0 || modidx >= NMODULI) {
+    fprintf(stderr, "modulo_index %d not in range [0,%d)\n", modidx, NMODULI);
+    return 1;
+  }
+  modulus = moduli[modidx];
+
+  max_frontier = find_order();
+  printf("%d vertices, max frontier %d\n", num_vertices, max_frontier);
+  if (max_frontier > MAXFRONTIER) {
+    fprintf(stderr, "The frontier must be at most %d.\n", MAXFRONTIER);
+    return 1;
+  }
+
+  num_legal = count_legal();
+
+  printf("Max number of frontier states: %lu\n", max_states);
+  printf("Time: %.2f s\n", (double) (clock() - start) / CLOCKS_PER_SEC);
+  printf("legal %% ");
+  if (modulus)
+    printf("%lu", modulus);
+  else
+    printf("18446744073709551616");
+  printf(" = %lu\n", num_legal);
+
+  return 0;
+}
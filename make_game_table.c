@@ -0,0 +1,160 @@
+/* make_game_table.c - Convert a compiled transition table to a table
+ * file for the --table option of the game tree programs.
+ *
+ * The table is read from the C source of one of those programs, or
+ * from the output of number_of_games.pike, by looking for
+ *
+ *   #define NUMBER_OF_STATES n
+ *   #define NUMBER_OF_POINTS p
+ *   int transformations[NUMBER_OF_STATES][2 * NUMBER_OF_POINTS] = {
+ *   { ... }, ...
+ *   };
+ *
+ * With --board name the table following the comment naming the board,
+ * such as 3x3, is taken, otherwise the first table in the file. The
+ * #if 0 around the tables is ignored, so every board in a source file
+ * is available without recompiling.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gametable.h"
+
+
+static void
+usage(void)
+{
+  fprintf(stderr, "Usage: make_game_table [--board name] source table\n");
+  exit(1);
+}
+
+
+/* Read the table from f into a newly allocated array, after the board
+ * comment if board is not NULL. Returns NULL if there is no such table.
+ */
+static int *
+read_table(FILE *f, const char *board, int *number_of_states,
+	   int *number_of_points)
+{
+  char line[4096];
+  char comment[256];
+  int found = board == NULL;
+  int *transformations = NULL;
+  int row = 0;
+  int n;
+
+  if (board)
+    snprintf(comment, sizeof(comment), "/* %s */", board);
+  *number_of_states = *number_of_points = 0;
+
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (!found) {
+      found = !strcmp(line, comment);
+      continue;
+    }
+    if (sscanf(line, "#define NUMBER_OF_STATES %d", &n) == 1)
+      *number_of_states = n;
+    else if (sscanf(line, "#define NUMBER_OF_POINTS %d", &n) == 1)
+      *number_of_points = n;
+    else if (!strncmp(line, "int transformations[", 20)) {
+      if (*number_of_states <= 0 || *number_of_points <= 0)
+	return NULL;
+      transformations = malloc(*number_of_states * 2 * *number_of_points
+			       * sizeof(int));
+      if (!transformations) {
+	fprintf(stderr, "Out of memory\n");
+	exit(1);
+      }
+    }
+    else if (transformations && line[0] == '{') {
+      char *p = line + 1;
+      char *end;
+      int k;
+
+      if (row == *number_of_states) {
+	fprintf(stderr, "More than %d rows\n", *number_of_states);
+	exit(1);
+      }
+      for (k = 0; k < 2 * *number_of_points; k++) {
+	transformations[row * 2 * *number_of_points + k]
+	  = strtol(p, &end, 10);
+	if (end == p) {
+	  fprintf(stderr, "Short row %d\n", row);
+	  exit(1);
+	}
+	p = end + strspn(end, " ,");
+      }
+      row++;
+    }
+    else if (transformations && !strncmp(line, "};", 2))
+      break;
+  }
+
+  if (transformations && row != *number_of_states) {
+    fprintf(stderr, "Only %d of %d rows\n", row, *number_of_states);
+    exit(1);
+  }
+  return transformations;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  struct gg_game_table table;
+  const char *board = NULL;
+  int *transformations;
+  int number_of_states;
+  int number_of_points;
+  FILE *f;
+  int i = 1;
+
+  if (i + 1 < argc && !strcmp(argv[i], "--board")) {
+    board = argv[i + 1];
+    i += 2;
+  }
+  if (argc - i != 2)
+    usage();
+
+  f = fopen(argv[i], "r");
+  if (!f) {
+    perror(argv[i]);
+    return 1;
+  }
+  transformations = read_table(f, board, &number_of_states,
+			       &number_of_points);
+  fclose(f);
+  if (!transformations) {
+    fprintf(stderr, "No %s%stable in %s\n", board ? board : "",
+	    board ? " " : "", argv[i]);
+    return 1;
+  }
+
+  gg_game_table_from_array(&table, transformations, number_of_states,
+			   number_of_points);
+  if (!gg_game_table_write(&table, argv[i + 1]))
+    return 1;
+  printf("%d states, %d points, %d moves, at most %d per state\n",
+	 table.number_of_states, table.number_of_points,
+	 table.number_of_moves, table.max_moves);
+  printf("%ld bytes, compiled table %ld bytes\n",
+	 (long) (sizeof(struct gg_game_table_header)
+		 + (table.number_of_states + 1) * sizeof(uint32_t)
+		 + (long) table.number_of_moves * table.target_bytes),
+	 (long) number_of_states * 2 * number_of_points * sizeof(int));
+
+  gg_game_table_free(&table);
+  free(transformations);
+  return 0;
+}
+
+
+/*
+ * Local Variables:
+ * tab-width: 8
+ * c-basic-offset: 2
+ * End:
+ */
@@ -9,6 +9,8 @@
 #include <math.h>
 #include <string.h>
 
+#include "bigalloc.h"
+
 struct entry {
   uint64_t state:57;
   uint64_t max_liberties_offset:7;
@@ -110,7 +112,7 @@ int main(int argc, char **argv)
   long table_size = max_entries * sizeof(table[0]);
   printf("max_states: %ld, max_entries: %ld, table size: %ld\n",
 	 max_states, max_entries, table_size);
-  table = malloc(table_size);
+  table = bigalloc(table_size);
   if (!table) {
     fprintf(stderr, "Failed to allocate %ld bytes for the table.\n",
 	    table_size);
@@ -424,5 +426,6 @@ int main(int argc, char **argv)
 
   printf("%dx%d: %d\n", M, N, max_number_of_liberties);
   
+  bigalloc_report();
   return EXIT_SUCCESS;
 }
@@ -26,6 +26,8 @@
 #include <stdint.h>
 #include <assert.h>
 
+#include "bigalloc.h"
+
 struct entry {
   uint64_t state:54;
   uint64_t max_strings:10;
@@ -77,8 +79,8 @@ int main(int argc, char **argv)
   
   int table_size = 2 * max_entries * sizeof(old_table[0]);
   printf("table size: %d\n", table_size);
-  old_table = malloc(table_size);
-  new_table = malloc(table_size);
+  old_table = bigalloc(table_size);
+  new_table = bigalloc(table_size);
   if (!old_table || !new_table) {
     fprintf(stderr, "Failed to allocate %d bytes for the tables.\n",
 	    2 * table_size);
@@ -153,5 +155,6 @@ int main(int argc, char **argv)
 
   printf("%dx%d: %d\n", M, N, max_number_of_strings);
   
+  bigalloc_report();
   return EXIT_SUCCESS;
 }
@@ -29,6 +29,8 @@
 #include <stdint.h>
 #include <assert.h>
 
+#include "bigalloc.h"
+
 struct entry {
   uint64_t state:54;
   uint64_t max_strings:10;
@@ -96,7 +98,7 @@ int main(int argc, char **argv)
   long max_entries = 2 * max_states + max_states / 10 + 10;
   long table_size = max_entries * sizeof(table[0]);
   printf("max_states: %ld, max_entries: %ld, table size: %ld\n", max_states, max_entries, table_size);
-  table = malloc(table_size);
+  table = bigalloc(table_size);
   if (!table) {
     fprintf(stderr, "Failed to allocate %ld bytes for the table.\n",
 	    table_size);
@@ -205,5 +207,6 @@ int main(int argc, char **argv)
 
   printf("%dx%d: %d\n", M, N, max_number_of_strings);
   
+  bigalloc_report();
   return EXIT_SUCCESS;
 }
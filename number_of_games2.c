@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include "gametable.h"
 
 #if 0
 /* 1x2 */
@@ -113,25 +115,26 @@ int transformations[NUMBER_OF_STATES][2 * NUMBER_OF_POINTS] = {
 };
 #endif
 
-int visiting_order[NUMBER_OF_STATES];
+static struct gg_game_table table;
+int *visiting_order;
 
 void play_games(int state, int *visited_states, unsigned long long *n, int depth)
 {
   int k;
+  uint32_t i;
   visited_states[state] = 1;
   visiting_order[depth] = state;
   (*n)++;
 
-  if (depth == NUMBER_OF_STATES - 1) {
-    for (k = 0; k < NUMBER_OF_STATES; k++)
+  if (depth == table.number_of_states - 1) {
+    for (k = 0; k < table.number_of_states; k++)
       printf("%d ", visiting_order[k]);
     printf("\n");
   }
   
-  for (k = 0; k < 2 * NUMBER_OF_POINTS; k++) {
-    int next_state = transformations[state][k];
-    if (next_state >= 0
-	&& !visited_states[next_state])
+  for (i = table.offsets[state]; i < table.offsets[state + 1]; i++) {
+    int next_state = gg_game_table_target(&table, i);
+    if (!visited_states[next_state])
       play_games(next_state, visited_states, n, depth + 1);
   }
   visited_states[state] = 0;
@@ -140,11 +143,21 @@ void play_games(int state, int *visited_states, unsigned long long *n, int depth
 int main(int argc, char **argv)
 {
   unsigned long long n = 0;
-  int visited_states[NUMBER_OF_STATES];
-  int k;
+  int *visited_states;
+  int i;
+
+  table.offsets = NULL;
+  for (i = 1; i < argc; i++)
+    if (!gg_parse_game_table(argc, argv, &i, &table)) {
+      fprintf(stderr, "Usage: number_of_games2 [--table file]\n");
+      return 1;
+    }
+  if (!table.offsets)
+    gg_game_table_from_array(&table, &transformations[0][0],
+			     NUMBER_OF_STATES, NUMBER_OF_POINTS);
 
-  for (k = 0; k < NUMBER_OF_STATES; k++)
-    visited_states[k] = 0;
+  visited_states = calloc(table.number_of_states, sizeof(int));
+  visiting_order = malloc(table.number_of_states * sizeof(int));
 
   play_games(0, visited_states, &n, 0);
   
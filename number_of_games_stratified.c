@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include "gametable.h"
 
 #define NUMBER_OF_STATES 4125
 #define NUMBER_OF_POINTS 8
@@ -4131,15 +4133,16 @@ int transformations[NUMBER_OF_STATES][2 * NUMBER_OF_POINTS] = {
 { 1,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 4124: .XXXXXXX */
 };
 
+static struct gg_game_table table;
+
 void play_games(int state, int *visited_states, unsigned long long *n)
 {
-  int k;
+  uint32_t i;
   visited_states[state] = 1;
   (*n)++;
-  for (k = 0; k < 2 * NUMBER_OF_POINTS; k++) {
-    int next_state = transformations[state][k];
-    if (next_state >= 0
-	&& !visited_states[next_state])
+  for (i = table.offsets[state]; i < table.offsets[state + 1]; i++) {
+    int next_state = gg_game_table_target(&table, i);
+    if (!visited_states[next_state])
       play_games(next_state, visited_states, n);
   }
   visited_states[state] = 0;
@@ -4148,11 +4151,20 @@ void play_games(int state, int *visited_states, unsigned long long *n)
 int main(int argc, char **argv)
 {
   unsigned long long n = 0;
-  int visited_states[NUMBER_OF_STATES];
-  int k;
+  int *visited_states;
+  int i;
+
+  table.offsets = NULL;
+  for (i = 1; i < argc; i++)
+    if (!gg_parse_game_table(argc, argv, &i, &table)) {
+      fprintf(stderr, "Usage: number_of_games_stratified [--table file]\n");
+      return 1;
+    }
+  if (!table.offsets)
+    gg_game_table_from_array(&table, &transformations[0][0],
+			     NUMBER_OF_STATES, NUMBER_OF_POINTS);
 
-  for (k = 0; k < NUMBER_OF_STATES; k++)
-    visited_states[k] = 0;
+  visited_states = calloc(table.number_of_states, sizeof(int));
 
   play_games(0, visited_states, &n);
   
@@ -50,8 +50,7 @@ static const unsigned int c = 0xdb8b0000U;
 
 
 /* Global state for the random number generator. */
-static unsigned int x[N];
-static int k;
+static struct gg_rand_state global_state;
 
 
 /* Set when properly seeded. */
@@ -69,7 +68,7 @@ static int rand_initialized = 0;
  */
 
 static void
-iterate_tgfsr(void)
+iterate_tgfsr(unsigned int *x)
 {
   int i;
   for (i = 0; i < N - m; i++)
@@ -79,22 +78,19 @@ iterate_tgfsr(void)
 }
 
 
-/* Produce a random number from the next word of the internal state.
+/* Produce a random number from the next word of the given state.
  */
 
 static unsigned int
-next_rand(void)
+next_rand_r(struct gg_rand_state *state)
 {
   int y;
-  if (!rand_initialized) {
-    assert(rand_initialized); /* Abort. */
-    gg_srand(1);              /* Initialize silently if assertions disabled. */
-  }
-  if (++k == N) {
-    iterate_tgfsr();
-    k = 0;
+  unsigned int *x = state->x;
+  if (++state->k == N) {
+    iterate_tgfsr(x);
+    state->k = 0;
   }
-  y = x[k] ^ ((x[k] << s) & b);
+  y = x[state->k] ^ ((x[state->k] << s) & b);
   y ^= ((y << t) & c);
 #if BIG_UINT
   y &= 0xffffffffU;
@@ -103,6 +99,88 @@ next_rand(void)
 }
 
 
+/* Store the next n words of the given state in buf. Each run of
+ * words up to the end of the block is tempered in a loop without
+ * dependencies between iterations.
+ */
+
+void
+gg_urand_fill_r(struct gg_rand_state *state, unsigned int *buf, int n)
+{
+  unsigned int *x = state->x;
+  int i, run;
+
+  while (n > 0) {
+    if (state->k == N - 1) {
+      iterate_tgfsr(x);
+      state->k = -1;
+    }
+    run = N - 1 - state->k;
+    if (run > n)
+      run = n;
+    for (i = 0; i < run; i++) {
+      unsigned int y = x[state->k + 1 + i];
+      y ^= (y << s) & b;
+      y ^= (y << t) & c;
+#if BIG_UINT
+      y &= 0xffffffffU;
+#endif
+      buf[i] = y;
+    }
+    state->k += run;
+    buf += run;
+    n -= run;
+  }
+}
+
+
+/* Seed a buffered generator with stream number STREAM of SEED. The
+ * 25 words of the TT800 state are drawn from the xoshiro256** stream
+ * of the same number, so that unlike with gg_srand_stream_r() the
+ * states of different streams are unrelated.
+ */
+
+void
+gg_srand_buffer(struct gg_rand_buffer *rb, unsigned int seed,
+		unsigned int stream)
+{
+  struct gg_xrand_state xstate;
+  int i;
+
+  gg_xsrand_stream_r(&xstate, seed, stream);
+  for (i = 0; i < N; i++)
+    rb->state.x[i] = gg_xurand_r(&xstate);
+  rb->state.k = N - 1;
+  rb->pos = GG_RAND_BUFFER_SIZE;
+}
+
+
+/* Refill the buffer of a buffered generator, a whole number of TT800
+ * blocks at a time.
+ */
+
+void
+gg_fill_rand_buffer(struct gg_rand_buffer *rb)
+{
+  gg_urand_fill_r(&rb->state, rb->buf, GG_RAND_BUFFER_SIZE);
+  rb->pos = 0;
+}
+
+
+/* Produce a random number from the next word of the global state.
+ */
+
+static unsigned int
+next_rand(void)
+{
+  if (!rand_initialized) {
+    assert(rand_initialized); /* Abort. */
+    gg_srand(1);              /* Initialize silently if assertions disabled. */
+  }
+  return next_rand_r(&global_state);
+}
+
+
 /* Seed the random number generator. The first word of the internal
  * state is set by the (lower) 32 bits of seed. The remaining 24 words
  * are generated from the first one by a linear congruential pseudo
@@ -116,18 +194,45 @@ next_rand(void)
 
 void
 gg_srand(unsigned int seed)
+{
+  gg_srand_r(&global_state, seed);
+  rand_initialized = 1;
+}
+
+
+/* Seed an explicit state in the same way as gg_srand() seeds the
+ * global one.
+ */
+
+void
+gg_srand_r(struct gg_rand_state *state, unsigned int seed)
 {
   int i;
   for (i = 0; i < N; i++) {
 #if BIG_UINT
     seed &= 0xffffffffU;
 #endif
-    x[i] = seed;
+    state->x[i] = seed;
     seed *= 1313;
     seed += 88897;
   }
-  k = N-1; /* Force an immediate iteration of the TGFSR. */
-  rand_initialized = 1;
+  state->k = N-1; /* Force an immediate iteration of the TGFSR. */
+}
+
+
+/* Seed an explicit state for stream number STREAM of SEED. Stream 0
+ * is the sequence gg_srand(seed) gives. Other streams start from seeds
+ * spaced by the golden ratio, which keeps them away from the short
+ * linear congruential orbit that gg_srand_r() fills the state from.
+ * Unlike the streams of gg_xsrand_stream_r(), these are not guaranteed
+ * not to overlap.
+ */
+
+void
+gg_srand_stream_r(struct gg_rand_state *state, unsigned int seed,
+		  unsigned int stream)
+{
+  gg_srand_r(state, seed + stream * 0x9e3779b9U);
 }
 
 
@@ -151,6 +256,35 @@ gg_urand(void)
 }
 
 
+/* Obtain one random integer value in the interval [0, 2^32-1] from an
+ * explicit state.
+ */
+
+unsigned int
+gg_urand_r(struct gg_rand_state *state)
+{
+  return next_rand_r(state);
+}
+
+
+/* Obtain one random integer value in the interval [0, n-1] from the
+ * given state, see gg_lemire_reduce().
+ */
+
+static unsigned int
+choice_r(struct gg_rand_state *state, unsigned int n)
+{
+  unsigned int k;
+  int ok;
+
+  do {
+    k = gg_lemire_reduce(next_rand_r(state), n, &ok);
+  } while (!ok);
+
+  return k;
+}
+
+
 /* Obtain one random floating point value in the half open interval
  * [0.0, 1.0).
  *
@@ -166,16 +300,184 @@ gg_drand(void)
 }
 
 
+/* Obtain one random integer value in the interval [0, n-1].
+ */
+
+unsigned int
+gg_choice(unsigned int n)
+{
+  if (!rand_initialized) {
+    assert(rand_initialized); /* Abort. */
+    gg_srand(1);              /* Initialize silently if assertions disabled. */
+  }
+  return choice_r(&global_state, n);
+}
+
+
+/* Obtain one random integer value in the interval [0, n-1] from an
+ * explicit state.
+ */
+
+unsigned int
+gg_choice_r(struct gg_rand_state *state, unsigned int n)
+{
+  return choice_r(state, n);
+}
+
+
+/* Obtain one random floating point value in the half open interval
+ * [0.0, 1.0) from an explicit state.
+ */
+
+double
+gg_drand_r(struct gg_rand_state *state)
+{
+  return next_rand_r(state) * 2.328306436538696e-10;
+}
+
+
+/* The xoshiro256** generator, see
+ *
+ * Blackman, D. and Vigna, S.: Scrambled linear pseudorandom number
+ * generators. ACM Transactions on Mathematical Software,
+ * Vol 47, No. 4, 2021, pp 36:1--36:32
+ */
+
+static inline uint64_t
+rotl(uint64_t v, int r)
+{
+  return (v << r) | (v >> (64 - r));
+}
+
+
+/* Seed the state with the splitmix64 sequence starting at seed, which
+ * cannot produce the forbidden all zero state.
+ */
+
+void
+gg_xsrand_r(struct gg_xrand_state *state, uint64_t seed)
+{
+  int i;
+  for (i = 0; i < 4; i++) {
+    uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    state->s[i] = z ^ (z >> 31);
+  }
+}
+
+
+/* Obtain one random integer value in the interval [0, 2^64-1].
+ */
+
+uint64_t
+gg_xurand64_r(struct gg_xrand_state *state)
+{
+  uint64_t *st = state->s;
+  uint64_t result = rotl(st[1] * 5, 7) * 9;
+  uint64_t tmp = st[1] << 17;
+
+  st[2] ^= st[0];
+  st[3] ^= st[1];
+  st[1] ^= st[2];
+  st[0] ^= st[3];
+  st[2] ^= tmp;
+  st[3] = rotl(st[3], 45);
+  return result;
+}
+
+
+/* Obtain one random integer value in the interval [0, 2^32-1], the
+ * upper half of the 64 bit output.
+ */
+
+unsigned int
+gg_xurand_r(struct gg_xrand_state *state)
+{
+  return (unsigned int) (gg_xurand64_r(state) >> 32);
+}
+
+
+/* Obtain one random floating point value in the half open interval
+ * [0.0, 1.0), with the full 53 bit mantissa.
+ */
+
+double
+gg_xdrand_r(struct gg_xrand_state *state)
+{
+  return (gg_xurand64_r(state) >> 11) * 0x1.0p-53;
+}
+
+
+/* Obtain one random integer value in the interval [0, n-1], see
+ * gg_lemire_reduce().
+ */
+
+unsigned int
+gg_xchoice_r(struct gg_xrand_state *state, unsigned int n)
+{
+  unsigned int k;
+  int ok;
+
+  do {
+    k = gg_lemire_reduce(gg_xurand_r(state), n, &ok);
+  } while (!ok);
+
+  return k;
+}
+
+
+/* Advance the state by 2^128 steps, using the jump polynomial
+ * published with the generator.
+ */
+
+void
+gg_xrand_jump(struct gg_xrand_state *state)
+{
+  static const uint64_t jump[4] = {
+    0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+    0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+  };
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int i, b;
+
+  for (i = 0; i < 4; i++)
+    for (b = 0; b < 64; b++) {
+      if (jump[i] & (1ULL << b)) {
+	s0 ^= state->s[0];
+	s1 ^= state->s[1];
+	s2 ^= state->s[2];
+	s3 ^= state->s[3];
+      }
+      gg_xurand64_r(state);
+    }
+  state->s[0] = s0;
+  state->s[1] = s1;
+  state->s[2] = s2;
+  state->s[3] = s3;
+}
+
+
+/* Seed state for stream number STREAM of SEED.
+ */
+
+void
+gg_xsrand_stream_r(struct gg_xrand_state *state, uint64_t seed,
+		   unsigned int stream)
+{
+  gg_xsrand_r(state, seed);
+  while (stream--)
+    gg_xrand_jump(state);
+}
+
+
 /* Retrieve the internal state of the random generator.
  */
 
 void
 gg_get_rand_state(struct gg_rand_state *state)
 {
-  int i;
-  for (i = 0; i < N; i++)
-    state->x[i] = x[i];
-  state->k = k;
+  *state = global_state;
 }
 
 
@@ -185,10 +487,7 @@ gg_get_rand_state(struct gg_rand_state *state)
 void
 gg_set_rand_state(struct gg_rand_state *state)
 {
-  int i;
-  for (i = 0; i < N; i++)
-    x[i] = state->x[i];
-  k = state->k;
+  global_state = *state;
 }
 
 
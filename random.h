@@ -23,6 +23,8 @@
 #ifndef _RANDOM_H_
 #define _RANDOM_H_
 
+#include <stdint.h>
+
 /* This random number generator produces 32 bit unsigned integers, no
  * more, no less. Internally in the algorithm and for storing the
  * state we need a type that is at least 32 bits wide. A longer type
@@ -48,6 +50,26 @@ struct gg_rand_state {
   int k;                /* Word counter. */
 };
 
+/* State of the xoshiro256** generator, see gg_xsrand_r() below. */
+struct gg_xrand_state {
+  uint64_t s[4];
+};
+
+/* Number of words a struct gg_rand_buffer holds, a multiple of the
+ * 25 word TT800 block.
+ */
+#define GG_RAND_BUFFER_SIZE 250
+
+/* A TT800 generator with a buffer of output words, filled a block at
+ * a time by gg_fill_rand_buffer(). The hot loops of the estimators draw
+ * from it through the inline functions at the end of this file.
+ */
+struct gg_rand_buffer {
+  struct gg_rand_state state;
+  int pos;              /* Next unused word of buf. */
+  unsigned int buf[GG_RAND_BUFFER_SIZE];
+};
+
 /* Seed the random number generator. If an unsigned int is larger than
  * 32 bits, only the 32 least significant bits are used for seeding.
  */
@@ -68,6 +90,63 @@ unsigned int gg_urand(void);
  */
 double gg_drand(void);
 
+/* Obtain one random integer value in the interval [0, n-1], n > 0. */
+unsigned int gg_choice(unsigned int n);
+
+/* Reentrant versions of the above, working on an explicit state so
+ * that every thread can have its own generator.
+ */
+void gg_srand_r(struct gg_rand_state *state, unsigned int seed);
+unsigned int gg_urand_r(struct gg_rand_state *state);
+double gg_drand_r(struct gg_rand_state *state);
+unsigned int gg_choice_r(struct gg_rand_state *state, unsigned int n);
+
+/* Seed an explicit state for stream number STREAM of SEED. Stream 0
+ * gives the same sequence as gg_srand(seed).
+ */
+void gg_srand_stream_r(struct gg_rand_state *state, unsigned int seed,
+		       unsigned int stream);
+
+/* Store the next n words of the state in buf. The words are the ones
+ * n calls of gg_urand_r() would return, but whole runs of the TT800
+ * block are tempered in one loop the compiler can vectorize.
+ */
+void gg_urand_fill_r(struct gg_rand_state *state, unsigned int *buf, int n);
+
+/* Seed a buffered generator with stream number STREAM of SEED. The
+ * TT800 state is filled from stream STREAM of gg_xsrand_stream_r(), so
+ * threads and replicas given different streams of one seed start from
+ * unrelated states.
+ */
+void gg_srand_buffer(struct gg_rand_buffer *rb, unsigned int seed,
+		     unsigned int stream);
+
+/* Refill the buffer of a buffered generator. */
+void gg_fill_rand_buffer(struct gg_rand_buffer *rb);
+
+/* The xoshiro256** generator of Blackman and Vigna, a faster
+ * companion to TT800 with 64 bit output, period 2^256 - 1, and a jump
+ * function that advances a state by 2^128 steps. Streams obtained by
+ * successive jumps from one seed never overlap in practice, so any
+ * number of threads or replicas can be handed their own; the buffered
+ * generators are seeded from them.
+ */
+void gg_xsrand_r(struct gg_xrand_state *state, uint64_t seed);
+uint64_t gg_xurand64_r(struct gg_xrand_state *state);
+unsigned int gg_xurand_r(struct gg_xrand_state *state);
+double gg_xdrand_r(struct gg_xrand_state *state);
+unsigned int gg_xchoice_r(struct gg_xrand_state *state, unsigned int n);
+
+/* Advance the state by 2^128 steps. */
+void gg_xrand_jump(struct gg_xrand_state *state);
+
+/* Seed state for stream number STREAM of SEED, i.e. seed and jump
+ * STREAM times. Handing out many streams is cheaper by seeding once
+ * and jumping a copy for each.
+ */
+void gg_xsrand_stream_r(struct gg_xrand_state *state, uint64_t seed,
+			unsigned int stream);
+
 /* Retrieve the internal state of the random generator. */
 void gg_get_rand_state(struct gg_rand_state *state);
 
@@ -75,6 +154,60 @@ void gg_get_rand_state(struct gg_rand_state *state);
 void gg_set_rand_state(struct gg_rand_state *state);
 
 
+/* Reduce the 32 bit random value x to the interval [0, n-1] by the
+ * multiply-shift method of Lemire (Fast random integer generation in
+ * an interval, ACM Transactions on Modeling and Computer Simulation,
+ * Vol 29, No. 1, 2019). The product x*n is accepted when its low word
+ * is at least 2^32 mod n, which keeps the result uniform; the costly
+ * division computing that bound is only done when the low word is
+ * below n, i.e. with probability n/2^32. Returns 0 in *ok if x must
+ * be replaced by a fresh value.
+ */
+static inline unsigned int
+gg_lemire_reduce(unsigned int x, unsigned int n, int *ok)
+{
+  uint64_t m = (uint64_t) x * n;
+  *ok = (uint32_t) m >= n || (uint32_t) m >= (uint32_t) -n % n;
+  return (unsigned int) (m >> 32);
+}
+
+/* Obtain one random integer value in the interval [0, 2^32-1] from a
+ * buffered generator.
+ */
+static inline unsigned int
+gg_urand_b(struct gg_rand_buffer *rb)
+{
+  if (rb->pos == GG_RAND_BUFFER_SIZE)
+    gg_fill_rand_buffer(rb);
+  return rb->buf[rb->pos++];
+}
+
+/* Obtain one random floating point value in the half open interval
+ * [0.0, 1.0) from a buffered generator.
+ */
+static inline double
+gg_drand_b(struct gg_rand_buffer *rb)
+{
+  return gg_urand_b(rb) * 2.328306436538696e-10;
+}
+
+/* Obtain one random integer value in the interval [0, n-1], n > 0,
+ * from a buffered generator.
+ */
+static inline unsigned int
+gg_choice_b(struct gg_rand_buffer *rb, unsigned int n)
+{
+  unsigned int k;
+  int ok;
+
+  do {
+    k = gg_lemire_reduce(gg_urand_b(rb), n, &ok);
+  } while (!ok);
+
+  return k;
+}
+
+
 #endif /* _RANDOM_H_ */
 
 
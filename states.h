@@ -15,3 +15,22 @@ int finalstate(Word_t s);
 // fill new with successor states of s
 // return number of new states, up to 3
 int expandstate(Word_t s, int x, Word_t *new);
+
+// codes stored by expandmoves for each successor: the content of cell x
+// in the color frame of s, plus MOVEFLIP if the successor swapped colors
+#define MOVEEMPTY 0
+#define MOVEBLACK 1
+#define MOVEWHITE 2
+#define MOVEFLIP 4
+
+// as expandstate, but if moves is non-NULL also store a move code per state
+int expandmoves(Word_t s, int x, Word_t *new, int *moves);
+
+// store in sizes the number of border cells of each needy string of s
+// before expanding cell x, in the order of their leftmost cells, and
+// return the number of needy strings
+int needystrings(Word_t s, int x, int *sizes, int *rightmost);
+
+// content of border cell i of s before expanding cell x, as a move code
+// in the same color frame as expandmoves uses, or -1 for the edge
+int bordercell(Word_t s, int x, int i);
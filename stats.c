@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "stats.h"
+
+
+void
+gg_stats_init(struct gg_stats *st)
+{
+  st->n = 0;
+  st->mean = 0.0;
+  st->m2 = 0.0;
+}
+
+
+void
+gg_stats_add(struct gg_stats *st, double x)
+{
+  double delta = x - st->mean;
+  st->n++;
+  st->mean += delta / st->n;
+  st->m2 += delta * (x - st->mean);
+}
+
+
+double
+gg_stats_variance(struct gg_stats *st)
+{
+  return st->n > 0 ? st->m2 / st->n : 0.0;
+}
+
+
+double
+gg_stats_stderr(struct gg_stats *st)
+{
+  if (st->n < 2)
+    return 0.0;
+  return sqrt(st->m2 / (st->n - 1) / st->n);
+}
+
+
+double
+gg_stats_rse(struct gg_stats *st)
+{
+  if (st->n < 2 || st->mean == 0.0)
+    return 0.0;
+  return gg_stats_stderr(st) / fabs(st->mean);
+}
+
+
+int
+gg_stats_reached(struct gg_stats *st, double target)
+{
+  return (st->n >= GG_STATS_MIN_SAMPLES
+	  && st->mean != 0.0
+	  && gg_stats_rse(st) <= target);
+}
+
+
+void
+gg_log_stats_init(struct gg_log_stats *st)
+{
+  st->n = 0;
+  st->scale = -HUGE_VAL;
+  st->mean = 0.0;
+  st->m2 = 0.0;
+}
+
+
+/* Add the sample exp(logx). When it exceeds all earlier ones the scale
+ * moves up to it first; the rescaled mean and m2 may underflow, but
+ * only when they are negligible next to the new sample anyway.
+ */
+
+void
+gg_log_stats_add(struct gg_log_stats *st, double logx)
+{
+  double x, delta, factor;
+
+  if (logx > st->scale) {
+    if (st->n > 0) {
+      factor = exp(st->scale - logx);
+      st->mean *= factor;
+      st->m2 *= factor * factor;
+    }
+    st->scale = logx;
+  }
+  x = exp(logx - st->scale);
+  delta = x - st->mean;
+  st->n++;
+  st->mean += delta / st->n;
+  st->m2 += delta * (x - st->mean);
+}
+
+
+double
+gg_log_stats_log_mean(struct gg_log_stats *st)
+{
+  return log(st->mean) + st->scale;
+}
+
+
+double
+gg_log_stats_rse(struct gg_log_stats *st)
+{
+  if (st->n < 2 || st->mean == 0.0)
+    return 0.0;
+  return sqrt(st->m2 / (st->n - 1) / st->n) / st->mean;
+}
+
+
+int
+gg_log_stats_reached(struct gg_log_stats *st, double target)
+{
+  return (st->n >= GG_STATS_MIN_SAMPLES
+	  && st->mean != 0.0
+	  && gg_log_stats_rse(st) <= target);
+}
+
+
+int
+gg_parse_target_rse(int argc, char **argv, int *i, double *target)
+{
+  if (strcmp(argv[*i], "--target-rse") || *i + 1 >= argc)
+    return 0;
+  *target = atof(argv[++*i]);
+  return 1;
+}
+
+
+/*
+ * Local Variables:
+ * tab-width: 8
+ * c-basic-offset: 2
+ * End:
+ */
@@ -0,0 +1,71 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+/* Streaming mean and variance of a sequence of samples, updated with
+ * Welford's method. Accumulating sum and sum of squares instead loses
+ * all precision in sumsq - sum^2/n once the relative spread of the
+ * samples is small compared to the number of them.
+ */
+struct gg_stats {
+  long n;               /* Number of samples. */
+  double mean;          /* Mean of the samples. */
+  double m2;            /* Sum of squared deviations from the mean. */
+};
+
+/* The same for samples given by their logarithm, for estimators whose
+ * samples do not fit in a double. Mean and m2 are kept relative to
+ * exp(scale) and exp(2 * scale), where scale is the largest logarithm
+ * added so far.
+ */
+struct gg_log_stats {
+  long n;
+  double scale;
+  double mean;
+  double m2;
+};
+
+/* Fewer samples than this never satisfy a target relative error, as
+ * the variance estimate itself is too unreliable.
+ */
+#define GG_STATS_MIN_SAMPLES 10
+
+void gg_stats_init(struct gg_stats *st);
+void gg_stats_add(struct gg_stats *st, double x);
+
+/* Variance of the samples, dividing the squared deviations by n. */
+double gg_stats_variance(struct gg_stats *st);
+
+/* Estimated standard error of the mean, and that relative to the
+ * mean. Both are 0 for fewer than two samples.
+ */
+double gg_stats_stderr(struct gg_stats *st);
+double gg_stats_rse(struct gg_stats *st);
+
+/* Whether the relative standard error is at most target, with at least
+ * GG_STATS_MIN_SAMPLES samples.
+ */
+int gg_stats_reached(struct gg_stats *st, double target);
+
+void gg_log_stats_init(struct gg_log_stats *st);
+void gg_log_stats_add(struct gg_log_stats *st, double logx);
+
+/* Logarithm of the mean of the samples. */
+double gg_log_stats_log_mean(struct gg_log_stats *st);
+
+double gg_log_stats_rse(struct gg_log_stats *st);
+int gg_log_stats_reached(struct gg_log_stats *st, double target);
+
+/* Parse a --target-rse option at argv[*i], advancing *i past its value.
+ * Return 1 and store the value if it is there, else return 0.
+ */
+int gg_parse_target_rse(int argc, char **argv, int *i, double *target);
+
+#endif /* _STATS_H_ */
+
+
+/*
+ * Local Variables:
+ * tab-width: 8
+ * c-basic-offset: 2
+ * End:
+ */
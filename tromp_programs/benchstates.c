@@ -0,0 +1,92 @@
+// time expandstate on the border states met in an exact sweep of a
+// width x width board, to compare the generic states.c kernel with the
+// per width instances compiled in with -DFIXEDWIDTHSTATES
+//
+// usage: benchstates width [passes]
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <Judy.h>
+#include "states.h"
+
+#ifndef BENCHSTATES
+#define BENCHSTATES 1000000L
+#endif
+#define NRUNS 3
+
+Word_t *states;
+int *cells;
+long nstates;
+
+// collect up to BENCHSTATES (state, cell) pairs, sweeping until full
+void collect(int wd)
+{
+  Pvoid_t oldt = (Pvoid_t)NULL, newt = (Pvoid_t)NULL;
+  Word_t *PValue,s,news[3],Rc_word;
+  int i,nnew,x,y;
+
+  states = malloc(BENCHSTATES * sizeof(Word_t));
+  cells = malloc(BENCHSTATES * sizeof(int));
+  if (!states || !cells) {
+    printf ("out of memory\n");
+    exit(0);
+  }
+  setwidth(wd);
+  JLI(PValue,newt,STARTSTATE);
+  for (nstates=y=0; y<wd; y++) {
+    for (x=0; x<wd; x++) {
+      JLFA(Rc_word,oldt); oldt = newt; newt = NULL;
+      s = 0L;
+      JLF(PValue,oldt,s);
+      while (PValue!=NULL) {
+        if (nstates == BENCHSTATES)
+          goto full;
+        states[nstates] = s;
+        cells[nstates++] = x;
+        nnew = expandstate(s, x, news);
+        for (i=0; i<nnew; i++)
+          JLI(PValue,newt,news[i]);
+        JLN(PValue,oldt,s);
+      }
+    }
+  }
+full:
+  JLFA(Rc_word,oldt);
+  JLFA(Rc_word,newt);
+}
+
+int main(int argc, char *argv[])
+{
+  Word_t news[3] = {0L,0L,0L}, sum;
+  struct timespec t0, t1;
+  double ns, best;
+  int wd, passes, p, r;
+  long i;
+
+  if (argc < 2) {
+    printf ("usage: %s width [passes]\n", argv[0]);
+    exit(0);
+  }
+  wd = atoi(argv[1]);
+  passes = argc > 2 ? atoi(argv[2]) : 40;
+  if (wd < 1 || wd > 21 || passes < 1) {
+    printf ("width %d out of range [1,21] or passes %d < 1\n", wd, passes);
+    exit(0);
+  }
+  collect(wd);
+  for (best=1e30,sum=r=0; r<NRUNS; r++) {
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (p=0; p<passes; p++)
+      for (i=0; i<nstates; i++)
+        sum += expandstate(states[i], cells[i], news) + news[0];
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec))
+       / ((double)passes * nstates);
+    if (ns < best)
+      best = ns;
+  }
+  printf ("width %d: %ld states, %.1f ns per expandstate (checksum %lx)\n",
+          wd, nstates, best, sum);
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "states.h"
+#include "eliasfano.h"
+#include "bigalloc.h"
+
+#define WORDS(bits) (((bits) + 63) / 64)
+
+void ef_init(eflayer *ef, Word_t n, Word_t maxkey)
+{
+  Word_t nlow, nhigh;
+
+  ef->n = n;
+  for (ef->lowbits = 0; n && (maxkey / n) >> (ef->lowbits + 1); ef->lowbits++) ;
+  nlow = WORDS(n * ef->lowbits) + 1; // +1 to read two words at once
+  nhigh = WORDS(n + (maxkey >> ef->lowbits) + 1);
+  ef->size = (nlow + nhigh + n) * sizeof(Word_t);
+  assert((ef->low = bigalloc(ef->size)));
+  ef->high = ef->low + nlow;
+  ef->cnts = ef->high + nhigh;
+  ef->pushed = ef->highpos = 0L;
+}
+
+void ef_push(eflayer *ef, Word_t key, Word_t cnt)
+{
+  Word_t i = ef->pushed++, bit, low;
+  Word_t hpos = (key >> ef->lowbits) + i; // i ones precede this one
+
+  assert(i < ef->n && hpos >= ef->highpos);
+  ef->high[hpos / 64] |= (Word_t)1 << (hpos % 64);
+  ef->highpos = hpos + 1;
+  if (ef->lowbits) {
+    low = key & (~(Word_t)0L >> (64 - ef->lowbits));
+    bit = i * ef->lowbits;
+    ef->low[bit / 64] |= low << (bit % 64);
+    if (bit % 64 + ef->lowbits > 64)
+      ef->low[bit / 64 + 1] |= low >> (64 - bit % 64);
+  }
+  ef->cnts[i] = cnt;
+}
+
+void ef_free(eflayer *ef)
+{
+  bigfree(ef->low, ef->size);
+}
+
+void ef_first(efiter *it, eflayer *ef)
+{
+  it->ef = ef;
+  it->i = it->highpos = 0L;
+}
+
+int ef_next(efiter *it, Word_t *key, Word_t *cnt)
+{
+  eflayer *ef = it->ef;
+  Word_t i = it->i, pos = it->highpos, w, bit, low = 0L;
+
+  if (i == ef->n)
+    return 0;
+  w = ef->high[pos / 64] >> (pos % 64); // find next one bit
+  while (!w) {
+    pos = (pos / 64 + 1) * 64;
+    w = ef->high[pos / 64];
+  }
+  pos += __builtin_ctzl(w);
+  it->highpos = pos + 1;
+  if (ef->lowbits) {
+    bit = i * ef->lowbits;
+    low = ef->low[bit / 64] >> (bit % 64);
+    if (bit % 64 + ef->lowbits > 64)
+      low |= ef->low[bit / 64 + 1] << (64 - bit % 64);
+    low &= ~(Word_t)0L >> (64 - ef->lowbits);
+  }
+  *key = (pos - i) << ef->lowbits | low;
+  *cnt = ef->cnts[i];
+  it->i = i + 1;
+  return 1;
+}
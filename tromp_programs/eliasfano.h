@@ -0,0 +1,33 @@
+// Elias-Fano coding of a sorted array of distinct states, with a flat
+// array of counts alongside. Keys take 2+log2(universe/n) bits each and
+// are decoded sequentially, which is all a completed layer needs.
+
+typedef struct {
+  Word_t n;        // number of keys
+  int lowbits;     // low bits stored verbatim per key
+  Word_t *low;     // n*lowbits bits
+  Word_t *high;    // unary coded high parts, n + (maxkey>>lowbits) + 1 bits
+  Word_t *cnts;    // count of key i
+  Word_t size;     // bytes allocated
+  Word_t pushed;   // keys pushed so far
+  Word_t highpos;  // bit position for the next push
+} eflayer;
+
+typedef struct {
+  eflayer *ef;
+  Word_t i;        // index of the next key
+  Word_t highpos;  // bit position after the last decoded high part
+} efiter;
+
+// allocate room for n keys up to maxkey
+void ef_init(eflayer *ef, Word_t n, Word_t maxkey);
+
+// append key, which must exceed the previous one, with its count
+void ef_push(eflayer *ef, Word_t key, Word_t cnt);
+
+void ef_free(eflayer *ef);
+
+void ef_first(efiter *it, eflayer *ef);
+
+// store the next key and its count, return 0 at the end
+int ef_next(efiter *it, Word_t *key, Word_t *cnt);
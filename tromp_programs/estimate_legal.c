@@ -4,17 +4,7 @@
 
 #define N 10
 
-static unsigned int random_choice(unsigned int n)
-{
-  unsigned int k;
-  unsigned int r = 0xffffffffU % n;
-
-  do {
-    k = gg_urand();
-  } while (k < r);
-
-  return k % n;
-}
+static struct gg_rand_buffer rb;
 
 int
 main(int argc, char **argv)
@@ -27,7 +17,7 @@ main(int argc, char **argv)
   double p = 1.0;
   int num_legal_final_states;
 
-  gg_srand(4);
+  gg_srand_buffer(&rb, 4, 0);
   
   for (k = 0; k < N; k++)
     states[k] = STARTSTATE;
@@ -48,7 +38,7 @@ main(int argc, char **argv)
       p *= (double) num_outstates / (3 * N);
 
       for (k = 0; k < N; k++)
-	states[k] = out_states[random_choice(num_outstates)];
+	states[k] = out_states[gg_choice_b(&rb, num_outstates)];
     }
       
   num_legal_final_states = 0;
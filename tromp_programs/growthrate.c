@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <Judy.h>
+#include "states.h"
+
+// power iteration on the row transfer operator of a fixed width:
+// sweep rows as memlegal does, but with floating point weights that are
+// normalized to sum 1 after every row. the sum before normalization
+// converges to the dominant eigenvalue, the growth rate of legal(wd x h)
+// as h goes to infinity. the ratio of successive changes estimates
+// |lambda2/lambda1|, which governs the convergence.
+
+#define W(p) (*(double *)(p)) // weights are stored in the Judy values
+
+int main(int argc, char *argv[])
+{
+  Pvoid_t oldt = (Pvoid_t)NULL, newt = (Pvoid_t)NULL;
+  Word_t *PValue,*QValue,s,news[3],Rc_word;
+  double sum,fsum,lambda = 0.0,prev = 0.0,change,prevchange = 0.0,tol = 1e-12;
+  int i,nnew,x,y,wd,maxrows = 50;
+
+  if (argc < 2) {
+    printf ("usage: %s width [maxrows [tolerance]]\n", argv[0]);
+    exit(0);
+  }
+  wd = atoi(argv[1]);
+  if (argc > 2)
+    maxrows = atoi(argv[2]);
+  if (argc > 3)
+    tol = atof(argv[3]);
+  setwidth(wd);
+  JLI(PValue,newt,STARTSTATE);
+  W(PValue) = 1.0;
+  for (y=0; y<maxrows; y++) {
+    for (x=0; x<wd; x++) {
+      JLFA(Rc_word,oldt); oldt = newt; newt = NULL;
+      s = 0L;
+      JLF(PValue,oldt,s);
+      while (PValue!=NULL) {
+        nnew = expandstate(s, x, news);
+        for (i=0; i<nnew; i++) {
+          JLI(QValue,newt,news[i]);
+          W(QValue) += W(PValue); // new entries are 0L, which is 0.0
+        }
+        JLN(PValue,oldt,s);
+      }
+    }
+    sum = fsum = 0.0;
+    s = 0L;
+    JLF(PValue,newt,s);
+    while (PValue!=NULL) {
+      sum += W(PValue);
+      if (finalstate(s))
+        fsum += W(PValue);
+      JLN(PValue,newt,s);
+    }
+    s = 0L;
+    JLF(PValue,newt,s);
+    while (PValue!=NULL) {
+      W(PValue) /= sum;
+      JLN(PValue,newt,s);
+    }
+    lambda = sum;
+    change = fabs(lambda - prev);
+    JLC(Rc_word, newt, 0L, -1L);
+    printf("row %d: lambda %.15f change %.3e", y+1, lambda, change);
+    if (y > 1 && prevchange > 0.0)
+      printf(" ratio %.4f", change / prevchange);
+    printf(" legal fraction %.6f states %lu\n", fsum / sum, Rc_word);
+    fflush(stdout);
+    if (y > 0 && change < tol * lambda)
+      break;
+    prev = lambda;
+    prevchange = change;
+  }
+  printf("growth rate of legal(%dxh): %.15f\n", wd, lambda);
+  JLFA(Rc_word,oldt);
+  JLFA(Rc_word,newt);
+  return 0;
+}
@@ -0,0 +1,69 @@
+// replacement for the JudyMalloc/JudyFree hooks of libJudy,
+// carving Judy nodes out of large bigalloc chunks so that the page size
+// and NUMA placement of Judy trees follow the BIGALLOC_* settings.
+// each thread has its own chunk and free lists, so no locking is needed.
+// freed nodes are kept on per-size free lists and never returned.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <Judy.h>
+#include "bigalloc.h"
+
+#define CHUNKWORDS (1L << 23) // 64 MB chunks
+#define MAXWORDS 256          // larger requests go to malloc
+
+typedef struct node {
+  struct node *next;
+} node;
+
+static __thread Word_t *chunk = NULL;
+static __thread Word_t chunkleft = 0L;
+static __thread node *freelist[MAXWORDS+1];
+
+Word_t JudyMalloc(int Words)
+{
+  Word_t *p;
+  node *f;
+
+  Words = (Words + 1) & ~1; // keep nodes 2-word aligned
+  if (Words > MAXWORDS)
+    return (Word_t)malloc(Words * sizeof(Word_t));
+  if ((f = freelist[Words])) {
+    freelist[Words] = f->next;
+    return (Word_t)f;
+  }
+  if (chunkleft < (Word_t)Words) {
+    if (!(chunk = bigalloc(CHUNKWORDS * sizeof(Word_t)))) {
+      chunkleft = 0L;
+      return 0L; // Judy reports JU_ERRNO_NOMEM
+    }
+    chunkleft = CHUNKWORDS;
+  }
+  p = chunk;
+  chunk += Words;
+  chunkleft -= Words;
+  return (Word_t)p;
+}
+
+void JudyFree(void *PWord, int Words)
+{
+  node *f = PWord;
+
+  Words = (Words + 1) & ~1;
+  if (Words > MAXWORDS) {
+    free(PWord);
+    return;
+  }
+  f->next = freelist[Words];
+  freelist[Words] = f;
+}
+
+Word_t JudyMallocVirtual(int Words)
+{
+  return JudyMalloc(Words);
+}
+
+void JudyFreeVirtual(void *PWord, int Words)
+{
+  JudyFree(PWord, Words);
+}
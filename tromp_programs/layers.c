@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <Judy.h>
+#include <assert.h>
+#include "states.h"
+#include "layers.h"
+
+#define NSHOWBUF 4
+#define MAXDIGITS (20*NCOUNTWORDS)
+
+void cnt_set(count_t *a, Word_t b)
+{
+  int i;
+
+  a->w[0] = b;
+  for (i=1; i<NCOUNTWORDS; i++)
+    a->w[i] = 0L;
+}
+
+void cnt_add(count_t *a, count_t *b)
+{
+  Word_t c,carry = 0L;
+  int i;
+
+  for (i=0; i<NCOUNTWORDS; i++) {
+    c = a->w[i] + b->w[i] + carry;
+    carry = carry ? c <= b->w[i] : c < b->w[i];
+    a->w[i] = c;
+  }
+  if (carry) {
+    printf("count overflow; recompile with NCOUNTWORDS > %d\n", NCOUNTWORDS);
+    exit(0);
+  }
+}
+
+void cnt_sub(count_t *a, count_t *b)
+{
+  Word_t c,borrow = 0L;
+  int i;
+
+  for (i=0; i<NCOUNTWORDS; i++) {
+    c = a->w[i] - b->w[i] - borrow;
+    borrow = borrow ? a->w[i] <= b->w[i] : a->w[i] < b->w[i];
+    a->w[i] = c;
+  }
+  assert(!borrow);
+}
+
+int cnt_cmp(count_t *a, count_t *b)
+{
+  int i;
+
+  for (i=NCOUNTWORDS; i--; )
+    if (a->w[i] != b->w[i])
+      return a->w[i] < b->w[i] ? -1 : 1;
+  return 0;
+}
+
+int cnt_bits(count_t *a)
+{
+  int i,b;
+
+  for (i=NCOUNTWORDS; i--; )
+    if (a->w[i])
+      for (b=64; b--; )
+        if (a->w[i] >> b)
+          return 64*i + b + 1;
+  return 0;
+}
+
+// a = a*m + d, return overflow
+static Word_t cnt_muladd(count_t *a, Word_t m, Word_t d)
+{
+  unsigned __int128 p;
+  int i;
+
+  for (i=0; i<NCOUNTWORDS; i++) {
+    p = (unsigned __int128)a->w[i] * m + d;
+    a->w[i] = (Word_t)p;
+    d = (Word_t)(p >> 64);
+  }
+  return d;
+}
+
+// a = a/m, return remainder
+static Word_t cnt_divmod(count_t *a, Word_t m)
+{
+  unsigned __int128 p;
+  Word_t r = 0L;
+  int i;
+
+  for (i=NCOUNTWORDS; i--; ) {
+    p = ((unsigned __int128)r << 64) | a->w[i];
+    a->w[i] = (Word_t)(p / m);
+    r = (Word_t)(p % m);
+  }
+  return r;
+}
+
+void cnt_mul(count_t *a, count_t *b, count_t *c)
+{
+  unsigned __int128 p;
+  Word_t carry;
+  count_t r;
+  int i,j;
+
+  cnt_set(&r, 0L);
+  for (i=0; i<NCOUNTWORDS; i++) {
+    for (carry=0L, j=0; i+j<NCOUNTWORDS; j++) {
+      p = (unsigned __int128)a->w[i] * b->w[j] + r.w[i+j] + carry;
+      r.w[i+j] = (Word_t)p;
+      carry = (Word_t)(p >> 64);
+    }
+    if (carry || (a->w[i] && cnt_bits(b) > 64*(NCOUNTWORDS-i))) {
+      printf("count overflow; increase NCOUNTWORDS\n");
+      exit(0);
+    }
+  }
+  *c = r;
+}
+
+Word_t cnt_div(count_t *a, Word_t m)
+{
+  return cnt_divmod(a, m);
+}
+
+double cnt_double(count_t *a)
+{
+  double d = 0.0;
+  int i;
+
+  for (i=NCOUNTWORDS; i--; )
+    d = d * 18446744073709551616.0 + a->w[i];
+  return d;
+}
+
+char *cnt_show(count_t *a)
+{
+  static char buffers[NSHOWBUF][MAXDIGITS+1],*buf;
+  static int bufnr = 0;
+  count_t q = *a;
+  int i;
+
+  buf = buffers[bufnr++];
+  if (bufnr == NSHOWBUF)
+    bufnr = 0; // buffer rotation
+  buf[i = MAXDIGITS] = '\0';
+  do buf[--i] = '0' + cnt_divmod(&q, 10L);
+  while (cnt_bits(&q));
+  return buf + i;
+}
+
+int cnt_parse(count_t *a, char *str)
+{
+  cnt_set(a, 0L);
+  if (!*str)
+    return 0;
+  for (; *str; str++)
+    if (*str < '0' || *str > '9' || cnt_muladd(a, 10L, *str - '0'))
+      return 0;
+  return 1;
+}
+
+static char *layername(int wd, int ht, int step)
+{
+  static char name[64];
+
+  sprintf(name, "layer.%d.%d.%d", wd, ht, step);
+  return name;
+}
+
+static void maplayer(layer *l, int wd, int ht, int step, int writable)
+{
+  struct stat st;
+  int fd;
+
+  if ((fd = open(layername(wd, ht, step), writable ? O_RDWR : O_RDONLY)) < 0
+   || fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(layerheader)) {
+    printf("cannot map %s; run build first\n", layername(wd, ht, step));
+    exit(0);
+  }
+  l->size = st.st_size;
+  l->hdr = mmap(NULL, l->size, PROT_READ | (writable ? PROT_WRITE : 0),
+                MAP_SHARED, fd, 0);
+  assert(l->hdr != MAP_FAILED);
+  close(fd);
+  if (l->hdr->magic != LAYERMAGIC || l->hdr->ncountwords != NCOUNTWORDS
+   || l->hdr->width != wd || l->hdr->height != ht || l->hdr->step != step
+   || l->size != sizeof(layerheader)
+                 + l->hdr->nstates * (sizeof(Word_t) + sizeof(count_t))) {
+    printf("%s does not match %dx%d with NCOUNTWORDS %d\n",
+           layername(wd, ht, step), ht, wd, NCOUNTWORDS);
+    exit(0);
+  }
+  l->keys = (Word_t *)(l->hdr + 1);
+  l->cnts = (count_t *)(l->keys + l->hdr->nstates);
+}
+
+static void unmaplayer(layer *l)
+{
+  munmap(l->hdr, l->size);
+}
+
+// write the keys of tree t, leaving the counts zero
+static void dumplayer(Pvoid_t t, int wd, int ht, int step)
+{
+  layerheader hdr;
+  Word_t s,Rc_word,*PValue;
+  count_t zero;
+  FILE *fp;
+
+  JLC(Rc_word, t, 0L, -1L);
+  hdr.magic = LAYERMAGIC;
+  hdr.ncountwords = NCOUNTWORDS;
+  hdr.width = wd;
+  hdr.height = ht;
+  hdr.step = step;
+  hdr.nstates = Rc_word;
+  assert((fp = fopen(layername(wd, ht, step), "w")));
+  assert(fwrite(&hdr, sizeof(hdr), 1, fp));
+  s = 0L;
+  JLF(PValue, t, s);
+  while (PValue!=NULL) {
+    assert(fwrite(&s, sizeof(Word_t), 1, fp));
+    JLN(PValue, t, s);
+  }
+  cnt_set(&zero, 0L);
+  for (s = 0L; s < hdr.nstates; s++)
+    assert(fwrite(&zero, sizeof(count_t), 1, fp));
+  fclose(fp);
+}
+
+void buildlayers(int wd, int ht)
+{
+  Pvoid_t oldt = (Pvoid_t)NULL, newt = (Pvoid_t)NULL;
+  Word_t *PValue,s,news[3],Rc_word;
+  int i,nnew,x,step,nsteps = wd*ht;
+  layer cur,next;
+  count_t *c;
+
+  JLI(PValue,newt,STARTSTATE);
+  for (step=0; step<nsteps; step++) {
+    x = step % wd;
+    dumplayer(newt, wd, ht, step);
+    JLFA(Rc_word,oldt); oldt = newt; newt = NULL;
+    s = 0L;
+    JLF(PValue,oldt,s);
+    while (PValue!=NULL) {
+      nnew = expandstate(s, x, news);
+      for (i=0; i<nnew; i++)
+        JLI(PValue,newt,news[i]);
+      JLN(PValue,oldt,s);
+    }
+  }
+  dumplayer(newt, wd, ht, nsteps);
+  JLFA(Rc_word,oldt);
+  JLFA(Rc_word,newt);
+
+  maplayer(&next, wd, ht, nsteps, 1);
+  for (s=0; s<next.hdr->nstates; s++)
+    cnt_set(&next.cnts[s], finalstate(next.keys[s]));
+  for (step=nsteps; step--; ) {
+    x = step % wd;
+    maplayer(&cur, wd, ht, step, 1);
+    for (s=0; s<cur.hdr->nstates; s++) {
+      nnew = expandstate(cur.keys[s], x, news);
+      for (i=0; i<nnew; i++) {
+        assert((c = lookup(&next, news[i])));
+        cnt_add(&cur.cnts[s], c);
+      }
+    }
+    printf("step %d: %lu states\n", step, cur.hdr->nstates);
+    fflush(stdout);
+    unmaplayer(&next);
+    next = cur;
+  }
+  unmaplayer(&next);
+}
+
+layer *maplayers(int wd, int ht)
+{
+  layer *layers;
+  int step;
+
+  assert((layers = malloc((wd*ht+1) * sizeof(layer))));
+  for (step=0; step<=wd*ht; step++)
+    maplayer(&layers[step], wd, ht, step, 0);
+  return layers;
+}
+
+count_t *lookup(layer *l, Word_t s)
+{
+  Word_t lo = 0L, hi = l->hdr->nstates, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (l->keys[mid] < s)
+      lo = mid + 1;
+    else hi = mid;
+  }
+  return lo < l->hdr->nstates && l->keys[lo] == s ? &l->cnts[lo] : NULL;
+}
+
+void unrank(layer *layers, int wd, int ht, count_t *index, char *board)
+{
+  Word_t s = STARTSTATE, news[3];
+  int i,m,nnew,step,flip = 0,moves[3];
+  count_t r = *index, *c;
+
+  for (step=0; step<wd*ht; step++) {
+    nnew = expandmoves(s, step % wd, news, moves);
+    for (i=0; i<nnew; i++) {
+      assert((c = lookup(&layers[step+1], news[i])));
+      if (cnt_cmp(&r, c) < 0)
+        break;
+      cnt_sub(&r, c);
+    }
+    assert(i < nnew); // index out of range
+    s = news[i];
+    m = moves[i] & ~MOVEFLIP; // colors in the frame of s, which is
+    board[step] = m == MOVEEMPTY ? '.' : "XO"[(m - MOVEBLACK) ^ flip];
+    flip ^= (moves[i] & MOVEFLIP) != 0; // flipped from the real colors
+  }
+  assert(finalstate(s));
+}
+
+int rank(layer *layers, int wd, int ht, char *board, count_t *index)
+{
+  Word_t s = STARTSTATE, news[3];
+  int i,m,nnew,step,flip = 0,moves[3];
+  count_t *c;
+
+  cnt_set(index, 0L);
+  for (step=0; step<wd*ht; step++) {
+    switch (board[step]) {
+      case '.': m = MOVEEMPTY; break;
+      case 'X': m = MOVEBLACK + flip; break;
+      case 'O': m = MOVEWHITE - flip; break;
+      default: return 0;
+    }
+    nnew = expandmoves(s, step % wd, news, moves);
+    for (i=0; i<nnew && (moves[i] & ~MOVEFLIP) != m; i++) {
+      assert((c = lookup(&layers[step+1], news[i])));
+      cnt_add(index, c);
+    }
+    if (i == nnew) // stone without liberties
+      return 0;
+    s = news[i];
+    flip ^= (moves[i] & MOVEFLIP) != 0;
+  }
+  return finalstate(s);
+}
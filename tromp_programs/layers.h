@@ -0,0 +1,66 @@
+// per-step border state tables with exact completion counts,
+// stored on disk as one file per step and memory-mapped for lookups
+
+#ifndef NCOUNTWORDS
+#define NCOUNTWORDS 2 // 128 bit counts are exact up to 9x9
+#endif
+
+#define LAYERMAGIC 0x6c6179657273L // "layers"
+
+typedef struct {
+  Word_t w[NCOUNTWORDS]; // least significant word first
+} count_t;
+
+typedef struct {
+  Word_t magic;
+  Word_t ncountwords;
+  Word_t width;
+  Word_t height;
+  Word_t step;
+  Word_t nstates;
+} layerheader;
+
+// file layout is header, sorted keys[nstates], counts[nstates]
+typedef struct {
+  layerheader *hdr;
+  Word_t *keys;
+  count_t *cnts;
+  size_t size;
+} layer;
+
+void cnt_set(count_t *a, Word_t b);
+void cnt_add(count_t *a, count_t *b);
+void cnt_sub(count_t *a, count_t *b);
+int cnt_cmp(count_t *a, count_t *b);
+int cnt_bits(count_t *a);
+
+// c = a*b, exit on overflow
+void cnt_mul(count_t *a, count_t *b, count_t *c);
+
+// a = a/m, return remainder
+Word_t cnt_div(count_t *a, Word_t m);
+
+double cnt_double(count_t *a);
+
+// decimal representation, uses the same kind of rotating buffers as showstate
+char *cnt_show(count_t *a);
+
+// parse a decimal string, return 0 on overflow or junk
+int cnt_parse(count_t *a, char *str);
+
+// forward sweep to collect the states of all wd*ht+1 steps,
+// then backward sweep to count legal completions of each state
+void buildlayers(int wd, int ht);
+
+// map the layers written by buildlayers, exit if missing or mismatched
+layer *maplayers(int wd, int ht);
+
+// completion count of state s in layer l, NULL if s is not present
+count_t *lookup(layer *l, Word_t s);
+
+// fill board with the ".XO" contents of the legal position of given index,
+// which must be less than the count of STARTSTATE in layer 0
+void unrank(layer *layers, int wd, int ht, count_t *index, char *board);
+
+// inverse of unrank; return 0 if board is not a legal position
+int rank(layer *layers, int wd, int ht, char *board, count_t *index);
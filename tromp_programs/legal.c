@@ -4,9 +4,11 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <string.h>
+#include <pthread.h>
 #include <Judy.h>
 #include <assert.h>
 #include "states.h"
+#include "bigalloc.h"
 
 #define NSIGNIFICANTSTATEBYTES 6
 #define STATECNTSIZE (NSIGNIFICANTSTATEBYTES+(int)sizeof(Word_t))
@@ -36,8 +38,7 @@ void mod_add(Word_t *a, Word_t b) {
   *a = c;
 }
 
-Word_t tsize = 0L, nlegal = 0L, nout = 0L;
-int ncpus, cpuid;
+int ncpus, cpuid, nthreads;
 
 #define MAXCPUS 4
 
@@ -67,7 +68,42 @@ void initsplit(int wd)
   fclose(fp);
 }
 
-void dumptree(Pvoid_t newt, char *basename, int extension, Word_t *splitit)
+typedef struct {
+  FILE *fp;
+  Word_t state;
+  Word_t cnt;
+} statebuf;
+statebuf startbuf = {NULL,STARTSTATE, 1L};
+
+#define MAXINFILES 99
+#define MAXTHREADS 64
+#define EMPTYBUF (-1L)
+#define ISEMPTYBUF(b) ((b)->state == EMPTYBUF)
+
+// each thread merges the input states in [lo,hi) into its own tree
+typedef struct {
+  pthread_t thread;
+  Word_t lo, hi;
+  statebuf buf[MAXINFILES];
+  int nbuf;
+  Word_t tsize, nin, noldin, nout, nlegal;
+} worker;
+
+worker workers[MAXTHREADS];
+int noutfiles = 0; // shared by all threads to number their dumps
+pthread_mutex_t outlock = PTHREAD_MUTEX_INITIALIZER;
+
+int nextoutfile()
+{
+  int n;
+
+  pthread_mutex_lock(&outlock);
+  n = noutfiles++;
+  pthread_mutex_unlock(&outlock);
+  return n;
+}
+
+void dumptree(worker *w, Pvoid_t newt, char *basename, int extension, Word_t *splitit)
 {
   Word_t Rc_word,t,*PValue;
   char outname[64];
@@ -82,10 +118,10 @@ void dumptree(Pvoid_t newt, char *basename, int extension, Word_t *splitit)
     while (PValue && t < splitit[i]) {
       if (*PValue) {
         if (finalstate(t))
-          mod_add(&nlegal, *PValue);
+          mod_add(&w->nlegal, *PValue);
         assert(fwrite(    &t,NSIGNIFICANTSTATEBYTES,1,fp));
         assert(fwrite(PValue,sizeof(Word_t),1,fp));
-        nout++;
+        w->nout++;
       } else printf("Not saving state %lo with count 0\n", t);
       JLN(PValue,newt,t);
     }
@@ -95,95 +131,166 @@ void dumptree(Pvoid_t newt, char *basename, int extension, Word_t *splitit)
   JLFA(Rc_word,newt);
 }
 
-typedef struct {
-  FILE *fp;
-  Word_t state;
-  Word_t cnt;
-} statebuf;
-statebuf startbuf = {NULL,STARTSTATE, 1L};
-
-#define MAXINFILES 99
-#define EMPTYBUF (-1L)
-#define ISEMPTYBUF(b) ((b)->state == EMPTYBUF)
-
-statebuf buf[MAXINFILES];
-Word_t nin = 0L, noldin = 0L;;
-int nbuf = 0;
-
-void fillbuf(statebuf *sb)
+void fillbuf(worker *w, statebuf *sb)
 {
-  if (fread(&sb->state,NSIGNIFICANTSTATEBYTES,1,sb->fp)) {
+  sb->state = 0L;
+  if (fread(&sb->state,NSIGNIFICANTSTATEBYTES,1,sb->fp) && sb->state < w->hi) {
    assert(fread(&sb->cnt,sizeof(Word_t),1,sb->fp));
-   nin++;
+   w->nin++;
   } else sb->state = EMPTYBUF;
 }
 
-statebuf *minbuf()
+statebuf *minbuf(worker *w)
 {
-  statebuf *sb, *mb = &buf[0];
+  statebuf *sb, *mb = &w->buf[0];
 
-  for (sb=&buf[1]; sb < &buf[nbuf]; sb++) {
+  for (sb=&w->buf[1]; sb < &w->buf[w->nbuf]; sb++) {
     if (sb->state < mb->state) // avoided for EMPTYBUF(rising i)
       mb = sb;
     else if (sb->state == mb->state && sb->state != EMPTYBUF) {
       mod_add(&mb->cnt, sb->cnt);
-      fillbuf(sb);
-      noldin++;
+      fillbuf(w, sb);
+      w->noldin++;
     }
   }
   return mb;
 }
 
-void cntlegal(Word_t maxtsize, char *inbase, char *outbase, int x) {
-  Pvoid_t newt = (Pvoid_t)NULL;
-  Word_t mins,mincnt,*PValue, news[3]; 
-  int i,j,nnew,noutfiles=0;
+Word_t nrecords(FILE *fp)
+{
+  fseek(fp, 0L, SEEK_END);
+  return ftell(fp) / STATECNTSIZE;
+}
+
+Word_t readstate(FILE *fp, Word_t i)
+{
+  Word_t state = 0L;
+
+  fseek(fp, i * STATECNTSIZE, SEEK_SET);
+  assert(fread(&state,NSIGNIFICANTSTATEBYTES,1,fp));
+  return state;
+}
+
+// position fp at the first record with state >= lo
+void seekstate(FILE *fp, Word_t lo)
+{
+  Word_t a = 0L, b = nrecords(fp), m;
+
+  while (a < b) {
+    m = (a + b) / 2;
+    if (readstate(fp, m) < lo)
+      a = m + 1;
+    else b = m;
+  }
+  fseek(fp, a * STATECNTSIZE, SEEK_SET);
+}
+
+int openinputs(worker *w, char *inbase)
+{
   char inname[64];
-  statebuf *mb;
+  int i,j;
 
-  for (i=nbuf=0; i<ncpus; i++) {
+  for (i=w->nbuf=0; i<ncpus; i++) {
     for (j=0; ; j++) {
       sprintf(inname,"%s.%d.%d.%d",inbase,i,j,cpuid); 
-      if (!(buf[nbuf].fp = fopen(inname, "r")))
+      if (!(w->buf[w->nbuf].fp = fopen(inname, "r")))
         break;
-      fillbuf(&buf[nbuf++]);
-      if (nbuf == MAXINFILES) {
+      if (w->lo)
+        seekstate(w->buf[w->nbuf].fp, w->lo);
+      fillbuf(w, &w->buf[w->nbuf++]);
+      if (w->nbuf == MAXINFILES) {
         printf ("MAXINFILES (%d) should exceed #inputfiles\n", MAXINFILES);
         exit(0);
       }
     }
   }
-  if (!nbuf)
-    return;
-  for (tsize = 0L; !ISEMPTYBUF(mb = minbuf()); ) {
-    mins = mb->state; mincnt = mb->cnt; fillbuf(mb);
+  return w->nbuf;
+}
+
+int cmpstate(const void *a, const void *b)
+{
+  Word_t s = *(Word_t *)a, t = *(Word_t *)b;
+  return s < t ? -1 : s > t;
+}
+
+#define SAMPLESPERTHREAD 256
+
+// cut the key space into nthreads ranges with about equally many input
+// records, using splitters sampled evenly from the sorted input runs
+void splitinputs(char *inbase)
+{
+  worker *w = &workers[0];
+  Word_t *samples = NULL, n, tot, i, ns;
+  int b, t;
+
+  w->lo = 0L; w->hi = EMPTYBUF;
+  if (nthreads == 1 || !openinputs(w, inbase))
+    ns = 0L;
+  else {
+    for (b=0, tot=0L; b<w->nbuf; b++)
+      tot += nrecords(w->buf[b].fp);
+    assert((samples = malloc((nthreads * SAMPLESPERTHREAD + w->nbuf) * sizeof(Word_t))));
+    for (b=0, ns=0L; b<w->nbuf; b++) {
+      n = nrecords(w->buf[b].fp);
+      for (i=0; i*tot < n*nthreads*SAMPLESPERTHREAD; i++)
+        samples[ns++] = readstate(w->buf[b].fp, i*tot/(nthreads*SAMPLESPERTHREAD));
+    }
+    qsort(samples, ns, sizeof(Word_t), cmpstate);
+  }
+  for (b=0; b<w->nbuf; b++)
+    fclose(w->buf[b].fp);
+  for (t=0; t<nthreads; t++) {
+    workers[t].lo = t ? workers[t-1].hi : 0L;
+    workers[t].hi = t < nthreads-1 && ns ? samples[(t+1)*ns/nthreads] : EMPTYBUF;
+  }
+  if (ns)
+    free(samples);
+}
+
+Word_t maxtsize;
+char inbase[64], outbase[64];
+int xstep;
+
+void *cntlegal(void *arg) {
+  worker *w = arg;
+  Pvoid_t newt = (Pvoid_t)NULL;
+  Word_t mins,mincnt,*PValue, news[3]; 
+  int i,nnew,x = xstep;
+  statebuf *mb;
+
+  if (w->lo == w->hi || !openinputs(w, inbase))
+    return NULL;
+  bigalloc_pin_thread(w - workers); // before judyalloc touches our chunks
+  for (w->tsize = 0L; !ISEMPTYBUF(mb = minbuf(w)); ) {
+    mins = mb->state; mincnt = mb->cnt; fillbuf(w, mb);
     //printf("state %lx count %lu\n", mins, mincnt);
     nnew = expandstate(mins, x, news);
     for (i=0; i<nnew; i++) {
       JLI(PValue, newt, news[i]);
       if (!*PValue) { // new tree entry
         *PValue = mincnt;
-        if (++tsize == maxtsize) {
-          dumptree(newt, outbase, noutfiles++, splits[x]);
-          newt = (Pvoid_t)NULL; tsize = 0L;
+        if (++w->tsize == maxtsize) {
+          dumptree(w, newt, outbase, nextoutfile(), splits[x]);
+          newt = (Pvoid_t)NULL; w->tsize = 0L;
         }
       } else mod_add(PValue,mincnt);
     }
   }
-  if (tsize)
-    dumptree(newt, outbase, noutfiles++, splits[x]);
-  for (i=0; i<nbuf ; i++)
-    fclose(buf[i].fp);
+  if (w->tsize)
+    dumptree(w, newt, outbase, nextoutfile(), splits[x]);
+  for (i=0; i<w->nbuf ; i++)
+    fclose(w->buf[i].fp);
+  return NULL;
 }
 
 int main(int argc, char *argv[])
 {
-  int modidx,wd,y,x,tsizelen;
-  Word_t maxtsize;
-  char c,*tsizearg,inbase[64],inname[64],outbase[64];
+  int modidx,wd,y,x,t,tsizelen;
+  Word_t nin,noldin,nout,nlegal;
+  char c,*tsizearg,inname[64];
 
-  if (argc!=6) {
-    printf ("usage: %s width modulo_index maxtreesize[kKmM] y x\n", argv[0]);
+  if (argc!=6 && argc!=7) {
+    printf ("usage: %s width modulo_index maxtreesize[kKmM] y x [nthreads]\n", argv[0]);
     exit(0);
   }
   setwidth(wd = atoi(argv[1]));
@@ -209,7 +316,13 @@ int main(int argc, char *argv[])
   if (c == 'm' || c == 'M')
     maxtsize *= 1000000L;
   y = atoi(argv[4]);
-  x = atoi(argv[5]);
+  xstep = x = atoi(argv[5]);
+  nthreads = argc > 6 ? atoi(argv[6]) : 1;
+  if (nthreads < 1 || nthreads > MAXTHREADS) {
+    printf ("#threads %d not in range [1,%d]\n", nthreads, MAXTHREADS);
+    exit(0);
+  }
+  maxtsize = (maxtsize + nthreads - 1) / nthreads; // memory is shared
   sprintf(inbase,"state.%d.%d.%d.%d",wd,modidx,y,x); 
   if (x==0 && y==0 && cpuid==0) {
     FILE *fp;
@@ -222,7 +335,17 @@ int main(int argc, char *argv[])
   printf("reading from %s.*.%d\n",inbase,cpuid);
   sprintf(outbase,"state.%d.%d.%d.%d",wd,modidx,y+(x+1)/wd,(x+1)%wd); 
 
-  cntlegal(maxtsize, inbase, outbase, x);
+  splitinputs(inbase);
+  for (t=0; t<nthreads; t++)
+    assert(!pthread_create(&workers[t].thread, NULL, cntlegal, &workers[t]));
+  nin = noldin = nout = nlegal = 0L;
+  for (t=0; t<nthreads; t++) {
+    assert(!pthread_join(workers[t].thread, NULL));
+    nin += workers[t].nin;
+    noldin += workers[t].noldin;
+    nout += workers[t].nout;
+    mod_add(&nlegal, workers[t].nlegal);
+  }
 
   printf("%lu states read with avg multiplicity %1.3lf\n",
           nin-noldin,nin/(double)(nin-noldin));
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "states.h"
+#include "layers.h"
+
+// per point and per neighbor pair counts over all legal positions.
+// the layers hold the backward (completion) counts, a forward sweep over
+// the same states gives the forward counts, and every transition
+// contributes forward count times completion count of its successor.
+// black and white counts are equal by color symmetry, so only empty and
+// stone are counted per point, and pairs of stones as same or opposite color.
+
+#define EE 0
+#define ES 1
+#define SE 2
+#define SAME 3
+#define OPP 4
+#define NPAIR 5
+
+static char *pairnames[NPAIR] = {"empty-empty", "empty-stone", "stone-empty", "same", "opposite"};
+
+int pairclass(int a, int b)
+{
+  if (a == MOVEEMPTY)
+    return b == MOVEEMPTY ? EE : ES;
+  if (b == MOVEEMPTY)
+    return SE;
+  return a == b ? SAME : OPP;
+}
+
+// correlation of the emptiness of two points
+double emptycorr(count_t *pair, count_t *total)
+{
+  double t = cnt_double(total), ee = cnt_double(&pair[EE]) / t;
+  double pa = ee + cnt_double(&pair[ES]) / t, pb = ee + cnt_double(&pair[SE]) / t;
+
+  return (ee - pa*pb) / sqrt(pa*(1-pa)*pb*(1-pb));
+}
+
+void showpair(int y0, int x0, int y, int x, count_t *pair, count_t *total)
+{
+  int k;
+
+  printf("pair (%d,%d)-(%d,%d):", y0, x0, y, x);
+  for (k=0; k<NPAIR; k++)
+    printf(" %s %.6f", pairnames[k], cnt_double(&pair[k]) / cnt_double(total));
+  printf(" corr %.6f\n", emptycorr(pair, total));
+}
+
+int main(int argc, char *argv[])
+{
+  int i,t,x,y,wd,ht,nnew,moves[3],left,up,cont;
+  Word_t n,news[3];
+  layer *layers;
+  count_t *total,*fwd,*next,*c,p,stones,black;
+  count_t *empty,(*hpair)[NPAIR],(*vpair)[NPAIR];
+
+  if (argc != 3 && argc != 4) {
+    printf ("usage: %s width height [build]\n", argv[0]);
+    exit(0);
+  }
+  wd = atoi(argv[1]);
+  ht = atoi(argv[2]);
+  if (wd > ht) {
+    i = wd; wd = ht; ht = i; // make width smaller than height
+  }
+  setwidth(wd);
+  if (argc > 3 && !strcmp(argv[3], "build"))
+    buildlayers(wd, ht);
+  layers = maplayers(wd, ht);
+  assert((total = lookup(&layers[0], STARTSTATE)));
+  assert((empty = calloc(wd*ht, sizeof(count_t))));
+  assert((hpair = calloc(wd*ht, sizeof(*hpair))));
+  assert((vpair = calloc(wd*ht, sizeof(*vpair))));
+  assert((fwd = calloc(1, sizeof(count_t))));
+  cnt_set(fwd, 1L); // layer 0 holds only STARTSTATE
+  for (t=0; t<wd*ht; t++) {
+    x = t % wd; y = t / wd;
+    assert((next = calloc(layers[t+1].hdr->nstates, sizeof(count_t))));
+    for (n=0; n<layers[t].hdr->nstates; n++) {
+      if (!cnt_bits(&fwd[n]))
+        continue;
+      up = y ? bordercell(layers[t].keys[n], x, x) : -1;
+      left = x ? bordercell(layers[t].keys[n], x, x-1) : -1;
+      nnew = expandmoves(layers[t].keys[n], x, news, moves);
+      for (i=0; i<nnew; i++) {
+        if (!(c = lookup(&layers[t+1], news[i])))
+          continue;
+        cnt_add(&next[c - layers[t+1].cnts], &fwd[n]);
+        if (!cnt_bits(c))
+          continue;
+        cnt_mul(&fwd[n], c, &p);
+        cont = moves[i] & ~MOVEFLIP;
+        if (cont == MOVEEMPTY)
+          cnt_add(&empty[t], &p);
+        if (left >= 0)
+          cnt_add(&hpair[t][pairclass(left, cont)], &p);
+        if (up >= 0)
+          cnt_add(&vpair[t][pairclass(up, cont)], &p);
+      }
+    }
+    free(fwd);
+    fwd = next;
+  }
+  free(fwd);
+
+  printf("legal(%dx%d) = %s\n", ht, wd, cnt_show(total));
+  for (t=0; t<wd*ht; t++) {
+    stones = *total;
+    cnt_sub(&stones, &empty[t]);
+    black = stones;
+    assert(!cnt_div(&black, 2L));
+    printf("point (%d,%d): empty %s black %s white %s\n", t/wd, t%wd,
+           cnt_show(&empty[t]), cnt_show(&black), cnt_show(&black));
+  }
+  for (t=0; t<wd*ht; t++) { // pairs with the left and upper neighbor
+    if (t % wd)
+      showpair(t/wd, t%wd-1, t/wd, t%wd, hpair[t], total);
+    if (t >= wd)
+      showpair(t/wd-1, t%wd, t/wd, t%wd, vpair[t], total);
+  }
+  return 0;
+}
@@ -1,9 +1,12 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <Judy.h>
 #include <assert.h>
 #include <mpi.h>
 #include "states.h"
+#include "bigalloc.h"
+#include "eliasfano.h"
 
 Word_t moduli[11]={
 0L, // 2^64                      // use up to  6x 6 for  64 bit precision
@@ -28,15 +31,159 @@ void mod_add(Word_t *a, Word_t b) {
   *a = c;
 }
 
+int efmode = 0; // freeze completed layers into Elias-Fano arrays
+Word_t maxmemory = 0L; // if set, split steps into passes over key ranges
+
+#define MAXPASSES 256
+#define NSPLITSAMPLES 4096
+
+// expand s with count c at column x into tree *newt, keeping keys in [lo,hi)
+void expand(Word_t s, Word_t c, int x, Pvoid_t *newt, Word_t lo, Word_t hi) {
+  Word_t *QValue,news[3];
+  int i,nnew;
+
+  nnew = expandstate(s, x, news);
+  for (i=0; i<nnew; i++) {
+    if (news[i] < lo || news[i] >= hi)
+      continue;
+    JLI(QValue,*newt,news[i]);
+    if (!*QValue) *QValue = c; else mod_add(QValue,c);
+  }
+}
+
+double judybytes = 16.0; // per state, updated from JLMU at every freeze
+
+// move the states and counts of tree t into ef, freeing t
+void freeze(Pvoid_t t, eflayer *ef) {
+  Word_t *PValue,s,n,Rc_word;
+
+  JLC(n, t, 0L, -1L);
+  if (n) {
+    JLMU(Rc_word, t);
+    if (Rc_word / (double)n > judybytes)
+      judybytes = Rc_word / (double)n;
+  }
+  s = -1L;
+  JLL(PValue,t,s);
+  ef_init(ef, n, PValue ? s : 0L);
+  s = 0L;
+  JLF(PValue,t,s);
+  while (PValue!=NULL) {
+    ef_push(ef, s, *PValue);
+    JLN(PValue,t,s);
+  }
+  JLFA(Rc_word,t);
+}
+
+// a layer frozen in one segment per key range, in increasing order
+typedef struct {
+  int nsegs;
+  eflayer segs[MAXPASSES];
+} eflayers;
+
+Word_t layersize(eflayers *l, Word_t *bytes) {
+  Word_t n = 0L;
+  int i;
+
+  for (*bytes = 0L, i=0; i<l->nsegs; i++) {
+    n += l->segs[i].n;
+    *bytes += l->segs[i].size;
+  }
+  return n;
+}
+
+int cmpword(const void *a, const void *b) {
+  Word_t s = *(Word_t *)a, t = *(Word_t *)b;
+  return s < t ? -1 : s > t;
+}
+
+// choose the number of passes for expanding layer old within maxmemory,
+// and cut the successor keys into that many ranges at sampled splitters.
+// the frozen segments of earlier passes stay in memory next to old, so
+// the tree of each pass gets what is left after old and the whole new
+// layer, taken to be frozen at the bytes per state of old
+int splitpasses(eflayers *old, int x, double growth, Word_t *splits) {
+  static Word_t samples[3*NSPLITSAMPLES];
+  Word_t n,bytes,s,c,news[3],k,every;
+  double need,avail;
+  efiter it;
+  int i,j,nnew,npasses,ns = 0;
+
+  n = layersize(old, &bytes);
+  splits[0] = -1L;
+  if (!maxmemory)
+    return 1;
+  need = n * growth * judybytes;
+  avail = (double)maxmemory - bytes - (n ? growth * bytes : 0.0);
+  npasses = avail <= 0.0 ? MAXPASSES : (int)(need / avail) + 1;
+  if (npasses > MAXPASSES)
+    npasses = MAXPASSES;
+  if (npasses == 1)
+    return 1;
+  every = n / NSPLITSAMPLES + 1;
+  for (k=0, i=0; i<old->nsegs; i++)
+    for (ef_first(&it, &old->segs[i]); ef_next(&it, &s, &c); k++)
+      if (k % every == 0) {
+        nnew = expandstate(s, x, news);
+        for (j=0; j<nnew; j++)
+          samples[ns++] = news[j];
+      }
+  qsort(samples, ns, sizeof(Word_t), cmpword);
+  for (i=0; i<npasses-1; i++)
+    splits[i] = samples[(Word_t)(i+1) * ns / npasses];
+  splits[npasses-1] = -1L;
+  return npasses;
+}
+
+// expand layer old at column x into new, one pass per key range
+void expandlayer(eflayers *old, eflayers *new, int x, double growth) {
+  Pvoid_t newt;
+  Word_t s,c,lo,splits[MAXPASSES];
+  efiter it;
+  int i,p,npasses;
+
+  npasses = splitpasses(old, x, growth, splits);
+  for (lo=0L, p=0; p<npasses; lo=splits[p++]) {
+    newt = (Pvoid_t)NULL;
+    if (splits[p] > lo) // empty range if splitters coincide
+      for (i=0; i<old->nsegs; i++)
+        for (ef_first(&it, &old->segs[i]); ef_next(&it, &s, &c); )
+          expand(s, c, x, &newt, lo, splits[p]);
+    freeze(newt, &new->segs[p]);
+  }
+  new->nsegs = npasses;
+}
+
 Word_t cntlegal(int wd, int ht) {
   Pvoid_t oldt = (Pvoid_t)NULL, newt = (Pvoid_t)NULL;
-  Word_t *PValue,*QValue,s,news[3],Rc_word,tot; 
-  int i,nnew,x,y;
+  Word_t *PValue,s,c,Rc_word,tot,bytes,n,oldn = 1L;
+  static eflayers efl[2];
+  eflayers *old = &efl[0], *new = &efl[1], *tmp;
+  double growth = 3.0;
+  efiter it;
+  int i,x,y;
 
   JLI(PValue,newt,STARTSTATE);
   *PValue = 1L;
+  if (efmode) {
+    freeze(newt, &new->segs[0]);
+    new->nsegs = 1;
+  }
   for (y=0; y<ht; y++) {
     for (x=0; x<wd; x++) {
+      if (efmode) {
+        n = layersize(new, &bytes);
+        printf("(%d,%d) size %ld in %d segments of %lu bytes\n",y,x,n,new->nsegs,bytes);
+        fflush(stdout);
+        if (oldn)
+          growth = n / (double)oldn;
+        oldn = n;
+        tmp = old; old = new; new = tmp;
+        expandlayer(old, new, x, growth);
+        for (i=0; i<old->nsegs; i++)
+          ef_free(&old->segs[i]);
+        continue;
+      }
       JLC(Rc_word, newt, 0L, -1L);
       printf("(%d,%d) size %ld\n",y,x,Rc_word);
       fflush(stdout);
@@ -44,19 +191,26 @@ Word_t cntlegal(int wd, int ht) {
       s = 0L;
       JLF(PValue,oldt,s);
       while (PValue!=NULL) {
-        nnew = expandstate(s, x, news);
-        for (i=0; i<nnew; i++) {
-          JLI(QValue,newt,news[i]);
-          if (!*QValue) *QValue = *PValue; else mod_add(QValue,*PValue);
-        }
+        expand(s, *PValue, x, &newt, 0L, -1L);
         JLN(PValue,oldt,s);
       }
     }
   }
+  tot = 0L;
+  if (efmode) {
+    printf("(%d,0) size %ld\n",ht,layersize(new, &bytes));
+    for (i=0; i<new->nsegs; i++) {
+      for (ef_first(&it, &new->segs[i]); ef_next(&it, &s, &c); )
+        if (finalstate(s))
+          mod_add(&tot,c);
+      ef_free(&new->segs[i]);
+    }
+    return tot;
+  }
   JLC(Rc_word, newt, 0L, -1L);
   printf("(%d,0) size %ld\n",ht,Rc_word);
   JLFA(Rc_word,oldt);
-  s = tot = 0L;
+  s = 0L;
   JLF(PValue,newt,s);
   while (PValue!=NULL) {
     if (finalstate(s))
@@ -70,10 +224,11 @@ Word_t cntlegal(int wd, int ht) {
 int main(int argc, char *argv[])
 {
   int i,wd,ht;
+  char c;
   Word_t tot;
 
   if (argc==1) {
-    printf ("usage: %s width [height [modulo_index (0-9)]]\n", argv[0]);
+    printf ("usage: %s width [height [modulo_index (0-9) [ef|maxmemory[kKmMgG]]]]\n", argv[0]);
     exit(0);
   }
   ht = wd = atoi(argv[1]);
@@ -84,6 +239,16 @@ int main(int argc, char *argv[])
   }
   if (argc > 3)
      modulus = moduli[atoi(argv[3])];
+  if (argc > 4) {
+     efmode = 1;
+     if (strcmp(argv[4], "ef")) { // memory budget
+       maxmemory = atol(argv[4]);
+       c = argv[4][strlen(argv[4])-1];
+       if (c == 'k' || c == 'K') maxmemory *= 1000L;
+       if (c == 'm' || c == 'M') maxmemory *= 1000000L;
+       if (c == 'g' || c == 'G') maxmemory *= 1000000000L;
+     }
+  }
   setwidth(wd);
   tot = cntlegal(wd, ht);
   printf("legal(%dx%d) %% ",ht,wd);
@@ -91,5 +256,6 @@ int main(int argc, char *argv[])
     printf("%lu",modulus);
   else printf("18446744073709551616");
   printf(" = %lu\n",tot);
+  bigalloc_report();
   return 0;
 }
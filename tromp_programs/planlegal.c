@@ -0,0 +1,185 @@
+// predict the states per step, memory, disk and work of a legal count
+// before launching it, from exact sweeps of narrower boards
+//
+// sampled sweeps badly underestimate the number of distinct border states:
+// rare states, like those with long needy strings, carry almost no path
+// weight, so even 200000 random walks on a 5 wide board miss a third of them.
+// instead, boards of width 2,3,... are swept exactly, keeping only the set of
+// states, until a sweep exceeds PLANMAXSTATES. the per step profile of the
+// widest such board is then scaled to the target width by the growth
+// factor between the last calibrated widths.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <Judy.h>
+#include "states.h"
+
+#define MAXWIDTH 21
+#define MAXSTEPS (MAXWIDTH*(MAXWIDTH+1)+1)
+#ifndef PLANMAXSTATES
+#define PLANMAXSTATES 2000000L
+#endif
+#define STATECNTSIZE (6+8) // as in legal.c
+
+typedef struct {
+  int wd, ht, nsteps, complete;
+  double states[MAXSTEPS]; // before step t = y*wd+x
+  double succ[MAXSTEPS];   // successors generated at step t
+  double bytes;            // judy bytes per state, at the peak
+  double peak;
+} profile;
+
+profile prof[MAXWIDTH+1];
+
+// exact sweep of a wd x ht board, giving up when a step exceeds maxstates
+void sweep(profile *p, int wd, int ht, Word_t maxstates)
+{
+  Pvoid_t oldt = (Pvoid_t)NULL, newt = (Pvoid_t)NULL;
+  Word_t *PValue,s,news[3],Rc_word,n,nsucc,mem;
+  int i,nnew,x,y,t;
+
+  p->wd = wd; p->ht = ht; p->peak = 0.0; p->complete = 0;
+  setwidth(wd);
+  JLI(PValue,newt,STARTSTATE);
+  for (t=y=0; y<ht; y++) {
+    for (x=0; x<wd; x++,t++) {
+      JLC(n, newt, 0L, -1L);
+      p->states[t] = n;
+      if (n > p->peak) {
+        p->peak = n;
+        JLMU(mem, newt);
+        p->bytes = mem / (double)n;
+      }
+      p->nsteps = t;
+      if (n > maxstates) {
+        JLFA(Rc_word,newt);
+        return;
+      }
+      JLFA(Rc_word,oldt); oldt = newt; newt = NULL;
+      nsucc = s = 0L;
+      JLF(PValue,oldt,s);
+      while (PValue!=NULL) {
+        nnew = expandstate(s, x, news);
+        nsucc += nnew;
+        for (i=0; i<nnew; i++)
+          JLI(PValue,newt,news[i]);
+        JLN(PValue,oldt,s);
+      }
+      p->succ[t] = nsucc;
+    }
+  }
+  JLC(n, newt, 0L, -1L);
+  p->states[t] = n;
+  p->nsteps = t;
+  p->complete = 1;
+  JLFA(Rc_word,oldt);
+  JLFA(Rc_word,newt);
+}
+
+// estimate for step y*wd+x of a wd x ht board from the profile of width w
+// x == wd stands for the end of row y, i.e. the states after its last step
+double scaled(profile *p, int wd, int y, int x, double growth, double *succ)
+{
+  int w = p->wd, y2, x2, t;
+  double f = pow(growth, wd - w);
+
+  if (w == wd) { // exact profile
+    t = y*wd + x;
+    *succ = p->succ[t];
+    return p->states[t];
+  }
+  y2 = (int)((double)y * w / wd + 0.5); // rows fill up in proportion to width
+  if (y >= wd || y2 >= p->ht)
+    y2 = p->ht - 1;
+  if (x == wd)
+    x2 = w;
+  else x2 = wd > 1 ? (int)((double)x * (w-1) / (wd-1) + 0.5) : 0;
+  t = y2*w + x2;
+  *succ = f * p->succ[t];
+  return f * p->states[t];
+}
+
+Word_t parsesize(char *arg)
+{
+  int len = strlen(arg);
+  char c = arg[len-1];
+  Word_t n = atol(arg);
+
+  if (c == 'k' || c == 'K') n *= 1000L;
+  if (c == 'm' || c == 'M') n *= 1000000L;
+  if (c == 'g' || c == 'G') n *= 1000000000L;
+  return n;
+}
+
+int main(int argc, char *argv[])
+{
+  int i,w,wd,ht,x,y,t,calw;
+  double growth,peak,peakpair,work,out,maxrun,bytes,maxtsize;
+  static double est[MAXSTEPS], esucc[MAXSTEPS];
+  Word_t memory = 0L;
+  profile *p;
+
+  if (argc < 2) {
+    printf ("usage: %s width [height [memory[kKmMgG]]]\n", argv[0]);
+    exit(0);
+  }
+  ht = wd = atoi(argv[1]);
+  if (argc > 2) {
+     if ((i = atoi(argv[2])) < wd)
+       wd = i;
+     else ht = i; // make width smaller than height
+  }
+  if (argc > 3)
+    memory = parsesize(argv[3]);
+  if (wd < 1 || wd > MAXWIDTH) {
+    printf ("width %d not in range [1,%d]\n", wd, MAXWIDTH);
+    exit(0);
+  }
+
+  // calibrate on narrower boards, of height w+1 to reach the saturated rows
+  for (calw=0, w=1; w<=wd; w++) {
+    p = &prof[w];
+    sweep(p, w, w == wd ? ht : (w+1 < ht ? w+1 : ht), PLANMAXSTATES);
+    if (!p->complete)
+      break;
+    calw = w;
+    printf("width %2d: peak %.0f states, %.1f bytes/state\n", w, p->peak, p->bytes);
+  }
+  if (calw == wd) {
+    printf("exact sweep of %dx%d fits in %ld states\n", ht, wd, PLANMAXSTATES);
+    growth = 1.0;
+  } else if (calw >= 3) {
+    growth = sqrt(prof[calw].peak / prof[calw-2].peak);
+    printf("growth factor per width %.3f\n", growth);
+  } else {
+    printf("could not calibrate on widths up to %d\n", calw);
+    exit(0);
+  }
+  p = &prof[calw];
+  bytes = p->bytes;
+  maxtsize = memory ? memory / bytes : HUGE_VAL;
+
+  for (t=y=0; y<ht; y++)
+    for (x=0; x<wd; x++,t++)
+      est[t] = scaled(p, wd, y, x, growth, &esucc[t]);
+  est[t] = scaled(p, wd, ht-1, wd, growth, &esucc[t]); // after the last step
+  peak = peakpair = work = maxrun = 0.0;
+  for (t=0; t<wd*ht; t++) {
+    printf("(%d,%d) states %.3g successors %.3g\n", t/wd, t%wd, est[t], esucc[t]);
+    if (est[t] > peak) peak = est[t];
+    if (est[t] + est[t+1] > peakpair) peakpair = est[t] + est[t+1];
+    work += esucc[t];
+    out = est[t+1] <= maxtsize ? est[t+1] : esucc[t]; // dumps overlap
+    if (out * STATECNTSIZE > maxrun) maxrun = out * STATECNTSIZE;
+  }
+  printf("peak states %.3g, total successors %.3g\n", peak, work);
+  printf("memlegal: peak RAM %.3g bytes (two trees at %.1f bytes/state)\n",
+         peakpair * bytes, bytes);
+  if (memory)
+    printf("legal: maxtreesize %.3g for %lu bytes\n", maxtsize, memory);
+  printf("legal: run files up to %.3g bytes per step, %.3g with input runs\n",
+         maxrun, 2.0 * maxrun);
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include "states.h"
+#include "layers.h"
+
+void showboard(char *board, int wd, int ht)
+{
+  int x,y;
+
+  for (y=0; y<ht; y++) {
+    for (x=0; x<wd; x++)
+      putchar(board[y*wd+x]);
+    putchar('\n');
+  }
+  putchar('\n');
+}
+
+int main(int argc, char *argv[])
+{
+  int i,c,wd,ht;
+  long n,nboards = 1L;
+  layer *layers;
+  count_t *total,index,one;
+  char *board;
+
+  if (argc < 4 || (strcmp(argv[3], "rank") && strcmp(argv[3], "unrank"))
+   || (!strcmp(argv[3], "unrank") && argc < 5)) {
+    printf ("usage: %s width height rank < boards\n", argv[0]);
+    printf ("       %s width height unrank index [nboards]\n", argv[0]);
+    exit(0);
+  }
+  wd = atoi(argv[1]);
+  ht = atoi(argv[2]);
+  if (wd > ht) {
+    i = wd; wd = ht; ht = i; // make width smaller than height
+  }
+  setwidth(wd);
+  layers = maplayers(wd, ht);
+  assert((total = lookup(&layers[0], STARTSTATE)));
+  assert((board = malloc(wd*ht)));
+  if (!strcmp(argv[3], "rank")) { // boards are read as wd*ht non-blanks
+    for (i=0; (c = getchar()) != EOF; ) {
+      if (isspace(c))
+        continue;
+      board[i++] = c;
+      if (i == wd*ht) {
+        if (rank(layers, wd, ht, board, &index))
+          printf("%s\n", cnt_show(&index));
+        else printf("illegal\n");
+        i = 0;
+      }
+    }
+    exit(0);
+  }
+  if (!cnt_parse(&index, argv[4])) {
+    printf("bad index %s\n", argv[4]);
+    exit(0);
+  }
+  if (argc > 5)
+    nboards = atol(argv[5]);
+  cnt_set(&one, 1L);
+  for (n=0; n<nboards && cnt_cmp(&index, total) < 0; n++) {
+    unrank(layers, wd, ht, &index, board);
+    showboard(board, wd, ht);
+    cnt_add(&index, &one);
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "states.h"
+#include "layers.h"
+#include "random.h"
+
+static struct gg_rand_buffer rb;
+
+// uniform in [0,n) by rejection on the bit length of n
+void randomindex(count_t *r, count_t *n)
+{
+  int i,nbits = cnt_bits(n);
+
+  do {
+    for (i=0; i<NCOUNTWORDS; i++) {
+      r->w[i] = (Word_t)gg_urand_b(&rb) << 32 | gg_urand_b(&rb);
+      if (64*(i+1) > nbits)
+        r->w[i] &= 64*i >= nbits ? 0L : ~(Word_t)0L >> (64*(i+1) - nbits);
+    }
+  } while (cnt_cmp(r, n) >= 0);
+}
+
+int main(int argc, char *argv[])
+{
+  int i,x,y,wd,ht;
+  long n,nsamples;
+  layer *layers;
+  count_t *total,r;
+  char *board;
+
+  if (argc != 4 && argc != 5) {
+    printf ("usage: %s width height build\n", argv[0]);
+    printf ("       %s width height nsamples seed\n", argv[0]);
+    exit(0);
+  }
+  wd = atoi(argv[1]);
+  ht = atoi(argv[2]);
+  if (wd > ht) {
+    i = wd; wd = ht; ht = i; // make width smaller than height
+  }
+  setwidth(wd);
+  if (!strcmp(argv[3], "build")) {
+    buildlayers(wd, ht);
+    exit(0);
+  }
+  nsamples = atol(argv[3]);
+  gg_srand_buffer(&rb, argc > 4 ? atoi(argv[4]) : 1, 0);
+  layers = maplayers(wd, ht);
+  assert((total = lookup(&layers[0], STARTSTATE)));
+  printf("legal(%dx%d) = %s\n", ht, wd, cnt_show(total));
+  assert((board = malloc(wd*ht)));
+  for (n=0; n<nsamples; n++) {
+    randomindex(&r, total);
+    unrank(layers, wd, ht, &r, board);
+    for (y=0; y<ht; y++) {
+      for (x=0; x<wd; x++)
+        putchar(board[y*wd+x]);
+      putchar('\n');
+    }
+    putchar('\n');
+  }
+  return 0;
+}
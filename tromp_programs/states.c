@@ -37,6 +37,17 @@ typedef cell bstate[MAXSTATEWIDTH]; // borderstate
 int statewidth; // global to save us from passing it to every function
 int thirdwidth,twothirdwidth;
 Word_t twothirdmask, thirdmask;
+// set by encode when it swaps colors; per thread, as the workers of legal
+// and the estimators expand states concurrently
+__thread int flipped;
+
+#ifdef FIXEDWIDTHSTATES
+// expansion goes through the stateskernel.h instance for the width,
+// chosen by setwidth; width 0 gets the generic code
+typedef int expander(Word_t s, int x, Word_t *new, int *moves);
+static expander *expanders[MAXSTATEWIDTH+1];
+static expander *kexpandmoves;
+#endif
 
 void setwidth(int wd)
 {
@@ -47,6 +58,9 @@ void setwidth(int wd)
   statewidth = wd;
   thirdmask = (1L << (3*(thirdwidth = statewidth/3))) - 1L;
   twothirdmask = (1L << (3*(twothirdwidth = statewidth - statewidth/3))) - 1L;
+#ifdef FIXEDWIDTHSTATES
+  kexpandmoves = expanders[wd];
+#endif
 }
 
 void wordtostate(Word_t s, int bump, bstate state)
@@ -136,15 +150,16 @@ Word_t encode(Word_t t, int bump, bstate state)
 {
   Word_t t1;
 
+  flipped = 0;
   if (bump == statewidth)
     bump = 0;
   if (!(t & NEEDY))
     t &= ~SENTINEL;
   if (ISNEEDY(t >> (3*bump))) {
     if (state[bump].needycolor == WHITE)
-      t = flipstones(t);
+      t = flipstones(t), flipped = 1;
   } else if ((t1 = flipstones(t)) < t)
-    t = t1;
+    t = t1, flipped = 1;
   if (SENTI(t))
     t = (t | HASL) & ~SENTINEL; // put sentinel bit in HASL if cell 0 needy
   if (bump >= twothirdwidth)
@@ -161,12 +176,61 @@ Word_t decode(Word_t s, int bump)
   return s;
 }
 
+int bordercell(Word_t s, int x, int i)
+{
+  bstate state;
+  int type;
+
+  s = decode(s, x);
+  wordtostate(s, x, state);
+  if ((type = state[i].type) == EDGE)
+    return -1;
+  if (type == EMPTY)
+    return MOVEEMPTY;
+  return MOVEBLACK + (ISNEEDY(type) ? state[i].needycolor : type & COLOR);
+}
+
+int needystrings(Word_t s, int x, int *sizes, int *rightmost)
+{
+  int stack[MAXSTATEWIDTH];
+  int i,id,sp,n,type;
+
+  s = decode(s, x);
+  for (i = sp = n = 0; i < statewidth; i++) {
+    type = (s >> (3*i)) & 7;
+    if (!ISNEEDY(type))
+      continue;
+    if (type & HASL)
+      sizes[id = stack[--sp]]++;
+    else sizes[id = n++] = 1;
+    if (rightmost)
+      rightmost[id] = i;
+    if (type & HASR)
+      stack[sp++] = id;
+  }
+  return n;
+}
+
 int finalstate(Word_t s)
 {
   return !(s & (NEEDY * ALLONES));
 }
 
 int expandstate(Word_t s, int x, Word_t *new)
+{
+  return expandmoves(s, x, new, NULL);
+}
+
+#ifdef FIXEDWIDTHSTATES
+int expandmoves(Word_t s, int x, Word_t *new, int *moves)
+{
+  return kexpandmoves(s, x, new, moves);
+}
+
+static int genericexpandmoves(Word_t s, int x, Word_t *new, int *moves)
+#else
+int expandmoves(Word_t s, int x, Word_t *new, int *moves)
+#endif
 {
   int nnew=0, col;
   cell left, up, edge;
@@ -186,7 +250,10 @@ int expandstate(Word_t s, int x, Word_t *new)
   if (x > 0)
     t = liberatecell(t, state, x-1);
   NSET(t,x,EMPTY);
-  new[nnew++] = encode(t, x+1, state);
+  new[nnew] = encode(t, x+1, state);
+  if (moves)
+    moves[nnew] = MOVEEMPTY | (flipped ? MOVEFLIP : 0);
+  nnew++;
   for (col=0; col<2; col++) {
     t = s; up = state[x];
     // extend border with stone at (x,y)
@@ -221,7 +288,64 @@ int expandstate(Word_t s, int x, Word_t *new)
       } else if (x == 0 && SENTI(t) == col)
         t ^= SENTINEL;
     }
-    new[nnew++] = encode(t, x+1, state);
+    new[nnew] = encode(t, x+1, state);
+    if (moves)
+      moves[nnew] = (MOVEBLACK + col) | (flipped ? MOVEFLIP : 0);
+    nnew++;
   }
   return nnew;
 }
+
+#ifdef FIXEDWIDTHSTATES
+#define KW 1
+#include "stateskernel.h"
+#define KW 2
+#include "stateskernel.h"
+#define KW 3
+#include "stateskernel.h"
+#define KW 4
+#include "stateskernel.h"
+#define KW 5
+#include "stateskernel.h"
+#define KW 6
+#include "stateskernel.h"
+#define KW 7
+#include "stateskernel.h"
+#define KW 8
+#include "stateskernel.h"
+#define KW 9
+#include "stateskernel.h"
+#define KW 10
+#include "stateskernel.h"
+#define KW 11
+#include "stateskernel.h"
+#define KW 12
+#include "stateskernel.h"
+#define KW 13
+#include "stateskernel.h"
+#define KW 14
+#include "stateskernel.h"
+#define KW 15
+#include "stateskernel.h"
+#define KW 16
+#include "stateskernel.h"
+#define KW 17
+#include "stateskernel.h"
+#define KW 18
+#include "stateskernel.h"
+#define KW 19
+#include "stateskernel.h"
+#define KW 20
+#include "stateskernel.h"
+#define KW 21
+#include "stateskernel.h"
+
+static expander *expanders[MAXSTATEWIDTH+1] = {
+  genericexpandmoves, expandmoves_1, expandmoves_2, expandmoves_3,
+  expandmoves_4, expandmoves_5, expandmoves_6, expandmoves_7, expandmoves_8,
+  expandmoves_9, expandmoves_10, expandmoves_11, expandmoves_12,
+  expandmoves_13, expandmoves_14, expandmoves_15, expandmoves_16,
+  expandmoves_17, expandmoves_18, expandmoves_19, expandmoves_20,
+  expandmoves_21
+};
+#endif
@@ -0,0 +1,150 @@
+// width dependent part of states.c, included with -DFIXEDWIDTHSTATES once
+// for every constant width KW from 1 to MAXSTATEWIDTH, so that the compiler
+// can unroll the loops over the border and fold the rotation masks. the
+// instances are named after their width, e.g. expandmoves_7.
+
+#define KCAT2(a,b) a##_##b
+#define KCAT(a,b) KCAT2(a,b)
+#define K(name) KCAT(name,KW)
+
+#define KTHIRD (KW/3)
+#define KTWOTHIRD (KW - KW/3)
+#define KTHIRDMASK ((1L << (3*KTHIRD)) - 1L)
+#define KTWOTHIRDMASK ((1L << (3*KTWOTHIRD)) - 1L)
+
+static void K(wordtostate)(Word_t s, int bump, bstate state)
+{
+  char stack[MAXSTATEWIDTH];
+  int sp,i,type,leftcolor;
+  cell *sti;
+
+  leftcolor = SENTI(s); // sentinel
+  sti = &state[0];
+  for (i = sp = 0; i < KW; sti++, i++) {
+    sti->type = type = (s >> (3*i)) & 7;
+    sti->left = sti->right = i;
+    if (ISNEEDY(type)) {
+      sti->needycolor = leftcolor ^ COLOR; // assume opposite color
+      if (type & HASL) {
+        if (!sp) {
+          printf("sp=0! i=%d s=%3lo bump=%d\n",i, s, bump);
+          exit(0);
+        }
+        sti->right = state[sti->left = stack[--sp]].right;
+        state[sti->left].right = state[sti->right].left = i;
+        sti->needycolor ^= (sti->left == i-1); // check color assumption
+      }
+      if (type & HASR)
+        stack[sp++] = i;
+      if (i == bump)
+        sti->needycolor = BLACK; // color normalization
+      leftcolor = sti->needycolor;
+    } else leftcolor = type & 1;
+  }
+  if (sp) {
+    printf("sp=%d s=%3lo bump=%d\n",sp, s, bump);
+    exit(0);
+  }
+}
+
+static Word_t K(encode)(Word_t t, int bump, bstate state)
+{
+  Word_t t1;
+
+  flipped = 0;
+  if (bump == KW)
+    bump = 0;
+  if (!(t & NEEDY))
+    t &= ~SENTINEL;
+  if (ISNEEDY(t >> (3*bump))) {
+    if (state[bump].needycolor == WHITE)
+      t = flipstones(t), flipped = 1;
+  } else if ((t1 = flipstones(t)) < t)
+    t = t1, flipped = 1;
+  if (SENTI(t))
+    t = (t | HASL) & ~SENTINEL; // put sentinel bit in HASL if cell 0 needy
+  if (bump >= KTWOTHIRD)
+    t = (t >> 3*KTHIRD) | ((t & KTHIRDMASK) << 3*KTWOTHIRD);
+  return t;
+}
+
+static Word_t K(decode)(Word_t s, int bump)
+{
+  if (bump >= KTWOTHIRD)
+    s = (s >> 3*KTWOTHIRD) | ((s & KTWOTHIRDMASK) << 3*KTHIRD);
+  if ((s & (NEEDY|HASL)) == (NEEDY|HASL))
+    s = (s & ~HASL) | SENTINEL;
+  return s;
+}
+
+static int K(expandmoves)(Word_t s, int x, Word_t *new, int *moves)
+{
+  int nnew=0, col;
+  cell left, up, edge;
+  bstate state;
+  Word_t t;
+
+#ifdef SHOWEXPAND
+  printf("exp(s=%3lo (%s), x=%d, new)\n",0*s, showstate(s,x), x);
+#endif
+  s = K(decode)(s, x);
+  K(wordtostate)(s, x, state);
+  edge.type = EDGE; ; edge.left = edge.right = x;
+  up = state[x];
+  left = x ? state[x-1] : edge;
+  // extend border with liberty at (x,y)
+  t = liberatecell(s, state, x);
+  if (x > 0)
+    t = liberatecell(t, state, x-1);
+  NSET(t,x,EMPTY);
+  new[nnew] = K(encode)(t, x+1, state);
+  if (moves)
+    moves[nnew] = MOVEEMPTY | (flipped ? MOVEFLIP : 0);
+  nnew++;
+  for (col=0; col<2; col++) {
+    t = s; up = state[x];
+    // extend border with stone at (x,y)
+    if (ISNEEDY(up.type) && up.needycolor != col) {
+      if (up.left == x) // singleton string
+        continue; // don't deprive last liberty
+      if (up.type & HASL) { // unlink
+        if (!(up.type & HASR))
+          t ^= (Word_t)HASR << (3*up.left);
+      } else if (up.type & HASR)
+        t ^= (Word_t)HASL << (3*up.right);
+      up = edge;
+    }
+    if (left.type == EMPTY || left.type == (LIBSTONE|col)) {
+      if (ISNEEDY(up.type)) // don't liberate edge shielded opposite
+        t = mustliberatecell(t, state, x, col);
+      NSET(t,x,LIBSTONE|col);
+    } else if (up.type == EMPTY || up.type == (LIBSTONE|col)) {
+      if (ISNEEDY(left.type) && left.needycolor == col)
+        t = mustliberatecell(t, state, x-1, col);
+      NSET(t,x,(LIBSTONE|col));
+    } else {
+      if (!(ISNEEDY(up.type)))
+        NSET(t,x,up.type = NEEDY);
+      if (ISNEEDY(left.type) && left.needycolor == col) {
+        if (up.type & HASL) {
+          if (!(left.type & HASR)) // not already merged
+            t |= (Word_t)HASL << (3*left.right);
+        } else if (left.type & HASR)
+          t |= (Word_t)HASR << (3*up.left);
+        t |= ((Word_t)((HASL<<3)|HASR) << (3*(x-1)));
+      } else if (x == 0 && SENTI(t) == col)
+        t ^= SENTINEL;
+    }
+    new[nnew] = K(encode)(t, x+1, state);
+    if (moves)
+      moves[nnew] = (MOVEBLACK + col) | (flipped ? MOVEFLIP : 0);
+    nnew++;
+  }
+  return nnew;
+}
+
+#undef KW
+#undef KTHIRD
+#undef KTWOTHIRD
+#undef KTHIRDMASK
+#undef KTWOTHIRDMASK